@@ -0,0 +1,194 @@
+import hashlib
+import os
+import sqlite3
+from concurrent.futures import ProcessPoolExecutor
+from datetime import datetime
+from typing import Dict, List, Optional, Tuple
+
+from algorithm.coverage_snapshot import CoverageSnapshot, FileCoverage, iter_bits
+from algorithm.gcov_merge import GcdaProfile
+from algorithm.gcov_reader import GcovFormatError, GcovReader
+
+# Parsed notes per worker process, reused across programs: {gcno path: (mtime_ns, reader)}
+_READERS: Dict[str, Tuple[int, GcovReader]] = {}
+
+
+def _program_coverage(prefix: str, profile_root: str) -> Tuple[Dict[str, Tuple[int, int, int]], Optional[str]]:
+    """
+    Line coverage of a single program from the .gcda files its compile wrote under prefix.
+    Module level so it can run in a process pool.
+    :return: ({source basename: (n_lines, executable bitset, covered bitset)}, error message or None)
+    """
+    files: Dict[str, FileCoverage] = {}
+    try:
+        for dirpath, _, names in os.walk(prefix):
+            for name in names:
+                if not name.endswith(".gcda"):
+                    continue
+                gcda = os.path.join(dirpath, name)
+                # Translation units the compile never entered only hold all-zero counters
+                try:
+                    if not any(counts is not None and any(counts) for _, counts in GcdaProfile(gcda).functions):
+                        continue
+                except GcovFormatError:
+                    pass
+                gcno = os.path.join(profile_root, os.path.relpath(gcda, prefix))[:-len(".gcda")] + ".gcno"
+                mtime = os.stat(gcno).st_mtime_ns
+                cached = _READERS.get(gcno)
+                if cached is None or cached[0] != mtime:
+                    cached = (mtime, GcovReader(gcno))
+                    _READERS[gcno] = cached
+                for source, counts in cached[1].recount(gcda).items():
+                    base = os.path.basename(source)
+                    cov = FileCoverage.from_counts(base, counts)
+                    prev = files.get(base)
+                    if prev is not None:
+                        cov.n_lines = max(cov.n_lines, prev.n_lines)
+                        cov.executable |= prev.executable
+                        cov.covered |= prev.covered
+                    files[base] = cov
+    except (OSError, GcovFormatError) as e:
+        return {}, f"{type(e).__name__}: {e}"
+    return {name: (f.n_lines, f.executable, f.covered) for name, f in files.items() if f.covered}, None
+
+
+def _mask_bytes(mask: int) -> bytes:
+    return mask.to_bytes((mask.bit_length() + 7) // 8, 'little')
+
+
+class CoverageAttributionDB:
+    """
+    Per-program coverage attribution, stored in SQLite:
+    program hash (+ compile options) -> newly covered lines per file.
+
+    Every program must be compiled into its own GCOV_PREFIX (CompileScheduler with per_program_profiles);
+    its counters are solved into line coverage and compared with the coverage before the batch.
+    """
+    SCHEMA = """
+    CREATE TABLE IF NOT EXISTS programs (
+        program_hash    TEXT NOT NULL,
+        compile_options TEXT NOT NULL,
+        path            TEXT,
+        target_file     TEXT,
+        compiled        INTEGER,
+        error           TEXT,
+        new_lines       INTEGER,
+        recorded_at     TEXT,
+        PRIMARY KEY (program_hash, compile_options)
+    );
+    CREATE TABLE IF NOT EXISTS new_lines (
+        program_hash    TEXT NOT NULL,
+        compile_options TEXT NOT NULL,
+        file            TEXT NOT NULL,
+        n_lines         INTEGER,
+        lines           BLOB,
+        PRIMARY KEY (program_hash, compile_options, file)
+    );
+    CREATE INDEX IF NOT EXISTS idx_programs_target ON programs (target_file);
+    CREATE INDEX IF NOT EXISTS idx_new_lines_file ON new_lines (file);
+    """
+
+    def __init__(self, db_path: str, profile_root: str, max_workers: Optional[int] = None):
+        """
+        :param db_path: SQLite database file (created if missing)
+        :param profile_root: directory the per-program GCOV_PREFIX trees mirror (where the .gcno files live)
+        :param max_workers: number of processes solving program profiles (default: os.cpu_count())
+        """
+        self.db_path = db_path
+        self.profile_root = profile_root
+        self.max_workers = max(1, max_workers or os.cpu_count() or 1)
+        self.conn = sqlite3.connect(db_path)
+        self.conn.executescript(self.SCHEMA)
+        self._pool: Optional[ProcessPoolExecutor] = None
+
+    @staticmethod
+    def program_hash(program_path: str) -> str:
+        with open(program_path, 'rb') as f:
+            return hashlib.sha1(f.read()).hexdigest()
+
+    def attribute(self, programs: List[Tuple[str, bool, Optional[str], str]], cov_before: CoverageSnapshot,
+                  target_file: str = "", compile_options: str = "") -> Dict[str, Dict[str, int]]:
+        """
+        Attribute newly covered lines to the programs of one batch and record them.
+        A line covered by several programs of the batch is credited to each of them.
+        :param programs: [(program_path, success, error_message, profile prefix)] (CompileScheduler before_fold)
+        :param cov_before: coverage before the batch
+        :return: {program_path: {file: bitset of newly covered lines}}
+        """
+        if self._pool is None:
+            self._pool = ProcessPoolExecutor(max_workers=self.max_workers)
+        futures = [self._pool.submit(_program_coverage, prefix, self.profile_root) for _, _, _, prefix in programs]
+
+        result: Dict[str, Dict[str, int]] = {}
+        now = datetime.now().isoformat(timespec="seconds")
+        with self.conn:
+            for (path, success, error, _), future in zip(programs, futures):
+                coverage, read_error = future.result()
+                if read_error:
+                    print(f"[Attribution] {os.path.basename(path)}: {read_error}")
+                files = {name: FileCoverage(name, n, executable, covered) for name, (n, executable, covered) in coverage.items()}
+                newly = CoverageSnapshot(files).newly_covered(cov_before)
+                result[path] = newly
+                try:
+                    program_hash = self.program_hash(path)
+                except OSError:
+                    continue
+                key = (program_hash, compile_options or "")
+                self.conn.execute("DELETE FROM new_lines WHERE program_hash = ? AND compile_options = ?", key)
+                self.conn.execute(
+                    "INSERT OR REPLACE INTO programs VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+                    key + (path, target_file, int(success), error, sum(bin(m).count("1") for m in newly.values()), now),
+                )
+                self.conn.executemany(
+                    "INSERT INTO new_lines VALUES (?, ?, ?, ?, ?)",
+                    [key + (name, bin(mask).count("1"), _mask_bytes(mask)) for name, mask in newly.items()],
+                )
+        productive = sum(1 for newly in result.values() if newly)
+        print(f"[Attribution] {productive}/{len(programs)} programs covered new lines")
+        return result
+
+    def productive_programs(self, target_file: Optional[str] = None) -> List[Tuple[str, str, str, int]]:
+        """
+        Programs that covered at least one new line, most productive first.
+        :return: [(program_hash, compile_options, path, new_lines)]
+        """
+        sql = "SELECT program_hash, compile_options, path, new_lines FROM programs WHERE new_lines > 0"
+        args: Tuple = ()
+        if target_file is not None:
+            sql += " AND target_file = ?"
+            args = (target_file,)
+        return self.conn.execute(sql + " ORDER BY new_lines DESC", args).fetchall()
+
+    def program_new_lines(self, program_hash: str, compile_options: str = "") -> Dict[str, List[int]]:
+        """:return: {file: newly covered line numbers} recorded for one program"""
+        rows = self.conn.execute(
+            "SELECT file, lines FROM new_lines WHERE program_hash = ? AND compile_options = ?",
+            (program_hash, compile_options),
+        ).fetchall()
+        return {name: list(iter_bits(int.from_bytes(blob, 'little'))) for name, blob in rows}
+
+    def programs_covering(self, file: str) -> List[Tuple[str, str, str, int]]:
+        """:return: [(program_hash, compile_options, path, n_lines)] of programs that newly covered lines of file"""
+        return self.conn.execute(
+            "SELECT p.program_hash, p.compile_options, p.path, n.n_lines FROM new_lines n "
+            "JOIN programs p USING (program_hash, compile_options) WHERE n.file = ? ORDER BY n.n_lines DESC",
+            (file,),
+        ).fetchall()
+
+    def program_record(self, program_hash: str, compile_options: str = "") -> Optional[Dict]:
+        row = self.conn.execute(
+            "SELECT path, target_file, compiled, error, new_lines FROM programs "
+            "WHERE program_hash = ? AND compile_options = ?",
+            (program_hash, compile_options),
+        ).fetchone()
+        if row is None:
+            return None
+        path, target_file, compiled, error, new_lines = row
+        return {"path": path, "target_file": target_file, "compiled": bool(compiled), "error": error,
+                "new_lines": new_lines, "files": self.program_new_lines(program_hash, compile_options)}
+
+    def close(self):
+        if self._pool is not None:
+            self._pool.shutdown()
+            self._pool = None
+        self.conn.close()
@@ -0,0 +1,112 @@
+import argparse
+import gc
+import importlib.util
+import json
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import time
+import tracemalloc
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+from algorithm import uncovered_analyzer  # noqa: E402
+
+_MODULE = "algorithm/uncovered_analyzer.py"
+
+
+def write_synthetic_gcov(path: str, lines: int = 50000, seed: int = 1):
+    """
+    Synthetic .gcov report with sparse coverage: 20% neutral comment lines, 4% isolated covered lines and
+    uncovered code in between, so long uncovered stretches split into thousands of blocks.
+    """
+    rng = random.Random(seed)
+    with open(path, "w", encoding="utf-8") as f:
+        f.write("        -:    0:Source:synthetic.c\n")
+        for i in range(1, lines + 1):
+            r = rng.random()
+            if r < 0.2:
+                f.write(f"        -:{i:5d}:  /* comment {i} */\n")
+            elif r < 0.24:
+                f.write(f"{rng.randint(1, 999):9d}:{i:5d}:  x{i} = y + {i};\n")
+            else:
+                f.write(f"    #####:{i:5d}:  z{i} = f (w, {i});\n")
+
+
+def load_reference(reference: str, workdir: str):
+    """
+    UncoveredBlockAnalyzer module to compare against: a file path, or a git revision whose
+    algorithm/uncovered_analyzer.py is used (default: the per-line dict implementation before the column store).
+    """
+    if not os.path.isfile(reference):
+        repo = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        if not reference:
+            columns = subprocess.run(["git", "log", "--reverse", "--format=%H", "-S", "covered_rank", "--", _MODULE],
+                                     cwd=repo, check=True, stdout=subprocess.PIPE, encoding="utf-8").stdout.split()
+            reference = columns[0] + "~1"
+        source = subprocess.run(["git", "show", f"{reference}:{_MODULE}"], cwd=repo, check=True,
+                                stdout=subprocess.PIPE, encoding="utf-8").stdout
+        path = os.path.join(workdir, "reference_analyzer.py")
+        with open(path, "w", encoding="utf-8") as f:
+            f.write(source)
+        reference = path
+    spec = importlib.util.spec_from_file_location("reference_analyzer", reference)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+def measure(module, gcov_file: str, context_limit: int, repeat: int):
+    """(best parse + blocks time, best block/context time, peak memory, analyzer) over repeat runs."""
+    best_parse = best_blocks = float("inf")
+    analyzer = None
+    for _ in range(repeat):
+        analyzer = module.UncoveredBlockAnalyzer(gcov_file, context_limit)
+        start = time.perf_counter()
+        analyzer.parse()
+        best_parse = min(best_parse, time.perf_counter() - start)
+        analyzer.blocks = []
+        start = time.perf_counter()
+        analyzer._build_blocks()
+        best_blocks = min(best_blocks, time.perf_counter() - start)
+    gc.collect()
+    tracemalloc.start()
+    module.UncoveredBlockAnalyzer(gcov_file, context_limit).parse()
+    _, peak = tracemalloc.get_traced_memory()
+    tracemalloc.stop()
+    return best_parse, best_blocks, peak, analyzer
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Time UncoveredBlockAnalyzer against a reference implementation "
+                                                 "on a synthetic .gcov report and check both give the same blocks")
+    parser.add_argument("--lines", type=int, default=50000, help="source lines of the synthetic report")
+    parser.add_argument("--context-limit", type=int, default=20)
+    parser.add_argument("--repeat", type=int, default=5, help="runs per implementation (best time is reported)")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--reference", default="", help="analyzer file or git revision to compare against")
+    parser.add_argument("--gcov", default="", help="use this .gcov report instead of a synthetic one")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory(prefix="bench_analyzer_") as workdir:
+        gcov_file = args.gcov
+        if not gcov_file:
+            gcov_file = os.path.join(workdir, "synthetic.c.gcov")
+            write_synthetic_gcov(gcov_file, args.lines, args.seed)
+        reference = load_reference(args.reference, workdir)
+        ref = measure(reference, gcov_file, args.context_limit, args.repeat)
+        cur = measure(uncovered_analyzer, gcov_file, args.context_limit, args.repeat)
+
+    identical = json.dumps(ref[3].blocks, sort_keys=True) == json.dumps(cur[3].blocks, sort_keys=True)
+    report = args.gcov or f"synthetic report ({args.lines} lines, seed {args.seed})"
+    print(f"{report}: {len(cur[3].blocks)} blocks, context_limit {args.context_limit}, "
+          f"output {'identical' if identical else 'DIFFERENT'}")
+    for label, i in (("parse + blocks", 0), ("blocks + context", 1)):
+        print(f"  {label}: {ref[i]:.3f}s -> {cur[i]:.3f}s (x{ref[i] / cur[i]:.2f})")
+    print(f"  peak memory: {ref[2] / 1e6:.1f} MB -> {cur[2] / 1e6:.1f} MB")
+    sys.exit(0 if identical else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,175 @@
+import glob
+import json
+import os
+import re
+import subprocess
+from concurrent.futures import ThreadPoolExecutor
+from typing import Dict, List, Optional, Set
+
+_SOURCE_EXTENSIONS = (".c", ".cc", ".cpp", ".cxx")
+# "  [  1a2f]  ../../gcc-14.3.0/gcc/fold-const.cc"
+_STRING_DUMP = re.compile(r"^\s*\[\s*[0-9a-f]+\]\s+(.*)$")
+# Symbols every executable (or every instrumented object) defines: no evidence of membership
+_COMMON_SYMBOL = re.compile(r"^(main|_sub_[ID]_\w+|__gcov\w*|_GLOBAL__\w+)$")
+
+COMPILE_PATH = "compile-path"  # linked into a binary a compile runs
+OTHER_BINARY = "other-binary"  # linked only into other tools (gcov, gcov-tool, ...)
+UNKNOWN = "unknown"  # instrumented but found in none of the binaries
+
+
+class BinaryMembership:
+    """
+    Which of the build's executables (cc1, cc1plus, lto1, xgcc, collect2, gcov, gcov-tool, ...) each
+    instrumented translation unit is linked into, and from that its reachability class: files linked only
+    into tools that compiling a program never runs (e.g. gcov-tool.cc) cannot gain coverage and are
+    excluded or down-weighted by GapSmithSelector.
+    Membership comes from the source names in each binary's DWARF strings (`readelf -p .debug_line_str
+    -p .debug_str`); binaries without debug info fall back to matching the global text symbols of each
+    .gcno's object file against the binary's symbol table (`nm`).
+    Results are keyed by translation unit stem (fold-const for fold-const.cc, as GcovRunner pairs .gcno files
+    with sources) and cached in a JSON file until a binary changes.
+    """
+    def __init__(self, build_dirs: List[str], binaries: List[str], compile_path: List[str],
+                 cache_path: str, max_workers: Optional[int] = None, timeout_sec: int = 300):
+        """
+        :param build_dirs: build directories holding the binaries and the .gcno/.o files (GcovRunner source_dirs)
+        :param binaries: executable names to inspect in build_dirs (missing ones are skipped)
+        :param compile_path: those of binaries that run when compiling a generated program
+        :param cache_path: reachability JSON ({stem: {"binaries", "class"}})
+        :param max_workers: concurrent nm processes of the symbol fallback
+        :param timeout_sec: timeout of one readelf/nm run
+        """
+        self.build_dirs = build_dirs
+        self.binaries = binaries
+        self.compile_path = set(compile_path)
+        self.cache_path = cache_path
+        self.max_workers = max_workers
+        self.timeout_sec = timeout_sec
+        self.files: Dict[str, Dict] = {}  # {stem: {"binaries": [...], "class": ...}}
+
+    def _run(self, args: List[str]):
+        """stdout lines of a binutils tool, empty if it fails."""
+        try:
+            res = subprocess.run(args, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, encoding="utf-8",
+                                 errors="replace", timeout=self.timeout_sec)
+        except (OSError, subprocess.TimeoutExpired):
+            return []
+        return res.stdout.splitlines()
+
+    def _binary_paths(self) -> Dict[str, str]:
+        paths = {}
+        for name in self.binaries:
+            for build_dir in self.build_dirs:
+                path = os.path.join(build_dir, name)
+                if os.path.isfile(path) and os.access(path, os.X_OK):
+                    paths[name] = path
+                    break
+        return paths
+
+    def _dwarf_stems(self, binary: str) -> Set[str]:
+        stems = set()
+        for line in self._run(["readelf", "--string-dump=.debug_line_str", "--string-dump=.debug_str", binary]):
+            m = _STRING_DUMP.match(line)
+            if m and m.group(1).endswith(_SOURCE_EXTENSIONS):
+                stems.add(os.path.splitext(os.path.basename(m.group(1).strip()))[0])
+        return stems
+
+    def _text_symbols(self, path: str, global_only: bool) -> Set[str]:
+        symbols = set()
+        for line in self._run(["nm", "-P", "--defined-only", path]):
+            parts = line.split()
+            if (len(parts) >= 2 and (parts[1] == "T" or not global_only and parts[1] == "t")
+                    and not _COMMON_SYMBOL.match(parts[0])):
+                symbols.add(parts[0])
+        return symbols
+
+    def _objects(self) -> Dict[str, str]:
+        """{stem: object file} of the instrumented translation units."""
+        objects = {}
+        for build_dir in self.build_dirs:
+            for gcno in glob.glob(os.path.join(build_dir, "*.gcno")):
+                stem = os.path.splitext(gcno)[0]
+                if os.path.isfile(stem + ".o"):
+                    objects[os.path.basename(stem)] = stem + ".o"
+        return objects
+
+    def _symbol_stems(self, binary: str, objects: Dict[str, str]) -> Set[str]:
+        linked = self._text_symbols(binary, global_only=False)
+
+        def member(item):
+            stem, obj = item
+            symbols = self._text_symbols(obj, global_only=True) or self._text_symbols(obj, global_only=False)
+            # Most of the object's functions are in the binary (a few may be dropped by the linker/LTO)
+            return stem if symbols and len(symbols & linked) * 2 >= len(symbols) else None
+        with ThreadPoolExecutor(max_workers=self.max_workers) as pool:
+            return {stem for stem in pool.map(member, objects.items()) if stem}
+
+    def refresh(self) -> Dict[str, Dict]:
+        """
+        Load the cached classes, or recompute them if a binary was added, removed or rebuilt.
+        :return: {stem: {"binaries": [...], "class": ...}}
+        """
+        paths = self._binary_paths()
+        stamps = {}
+        for name, path in paths.items():
+            st = os.stat(path)
+            stamps[name] = [st.st_mtime_ns, st.st_size]
+        try:
+            with open(self.cache_path, encoding="utf-8") as f:
+                cached = json.load(f)
+            if (cached.get("binaries") == stamps
+                    and sorted(cached.get("compile_path", [])) == sorted(self.compile_path)):
+                self.files = cached["files"]
+                return self.files
+        except (OSError, ValueError, KeyError):
+            pass
+
+        objects = self._objects()
+        members: Dict[str, List[str]] = {stem: [] for stem in objects}
+        methods = {}
+        for name, path in paths.items():
+            stems = self._dwarf_stems(path)
+            methods[name] = "dwarf"
+            if not stems & set(objects):
+                stems = self._symbol_stems(path, objects)
+                methods[name] = "symbols"
+            for stem in stems:
+                if stem in members:
+                    members[stem].append(name)
+        self.files = {}
+        for stem, binaries in members.items():
+            if not binaries:
+                cls = UNKNOWN
+            elif self.compile_path & set(binaries):
+                cls = COMPILE_PATH
+            else:
+                cls = OTHER_BINARY
+            self.files[stem] = {"binaries": binaries, "class": cls}
+        os.makedirs(os.path.dirname(self.cache_path) or ".", exist_ok=True)
+        with open(self.cache_path + ".tmp", "w", encoding="utf-8") as f:
+            json.dump({"binaries": stamps, "compile_path": sorted(self.compile_path), "methods": methods,
+                       "files": self.files}, f, indent=1)
+        os.replace(self.cache_path + ".tmp", self.cache_path)
+        counts = {}
+        for info in self.files.values():
+            counts[info["class"]] = counts.get(info["class"], 0) + 1
+        print(f"[Membership] {len(paths)} binaries ({', '.join(f'{n}: {m}' for n, m in methods.items())}), "
+              f"files: {counts}")
+        return self.files
+
+    def reachability(self, file_name: str) -> str:
+        """Reachability class of a source file (by path or basename)."""
+        stem = os.path.splitext(os.path.basename(file_name.replace("\\", "/")))[0]
+        return self.files.get(stem, {}).get("class", UNKNOWN)
+
+    def file_weights(self, unreachable_weight: float = 0.0) -> Dict[str, float]:
+        """
+        Selector weights of the files linked only outside the compile path, keyed by source basename
+        (see GapSmithSelector file_weights; 0 excludes them)
+        """
+        weights = {}
+        for stem, info in self.files.items():
+            if info["class"] == OTHER_BINARY:
+                for ext in _SOURCE_EXTENSIONS:
+                    weights[stem + ext] = unreachable_weight
+        return weights
@@ -0,0 +1,262 @@
+import glob
+import hashlib
+import json
+import os
+import re
+import threading
+from typing import Dict, List, Optional, Set
+
+from algorithm.uncovered_analyzer import KIND_COVERED, UNCOVERED, UncoveredBlockAnalyzer
+
+# Column-0 function definition head: "static tree\nfold_binary (...)" (GNU style) or "int foo(...)"
+_FUNCTION_HEAD = re.compile(r"^(?:[A-Za-z_][\w\s\*:<>,&]*?[\s\*&])?([A-Za-z_][\w:~]*)\s*\([^;]*$")
+_NOT_FUNCTIONS = {"if", "while", "for", "switch", "return", "sizeof", "do", "else", "case"}
+
+
+def _enclosing_functions(codes: List[str]) -> List[str]:
+    """Name of the function each line lies in (best effort, "" before the first definition)."""
+    names = []
+    current = ""
+    for code in codes:
+        if code[:1] not in ("", " ", "\t", "{", "}", "#", "/", "*"):
+            m = _FUNCTION_HEAD.match(code)
+            if m and m.group(1) not in _NOT_FUNCTIONS:
+                current = m.group(1)
+        names.append(current)
+    return names
+
+
+class BlockIndex:
+    """
+    Persistent index of the uncovered blocks of every file, kept in one JSON shard per file under index_dir.
+    update() rebuilds a file's shard only when its coverage changed (the .gcov report or in-memory counts
+    differ from the indexed signature); best_block() is then a lookup instead of a report re-parse.
+    Each block records its size, covered-context span, enclosing function and how often it was targeted.
+    With a source_index it also records how many of its guarding conditions are uncovered, and
+    update_frontier() adds its distance from the covered frontier over the static call graph, which
+    best_block() uses to prefer near-frontier blocks.
+    """
+    def __init__(self, index_dir: str, context_limit: int = 20, max_attempts: Optional[int] = None,
+                 source_index=None):
+        """
+        :param index_dir: directory of the per-file shards (reloaded on start)
+        :param context_limit: covered context lines before/after a block (as UncoveredBlockAnalyzer)
+        :param max_attempts: blocks targeted this often without being covered are passed over (None = never)
+        :param source_index: SourceIndex giving blocks their function/condition context (None = line window)
+        """
+        self.index_dir = index_dir
+        self.context_limit = context_limit
+        self.max_attempts = max_attempts
+        self.source_index = source_index
+        os.makedirs(index_dir, exist_ok=True)
+        self._shards: Dict[str, Dict] = {}  # {file basename: {"signature", "blocks"}}
+        self._lock = threading.Lock()
+        self.last_update_stats = {"files": 0, "rebuilt": 0}
+
+    def _shard_path(self, base_name: str) -> str:
+        return os.path.join(self.index_dir, base_name + ".json")
+
+    def _shard(self, base_name: str) -> Optional[Dict]:
+        if base_name not in self._shards:
+            try:
+                with open(self._shard_path(base_name), encoding="utf-8") as f:
+                    self._shards[base_name] = json.load(f)
+            except (OSError, ValueError):
+                return None
+        return self._shards[base_name]
+
+    def _save(self, base_name: str):
+        path = self._shard_path(base_name)
+        with open(path + ".tmp", "w", encoding="utf-8") as f:
+            json.dump(self._shards[base_name], f)
+        os.replace(path + ".tmp", path)
+
+    def _signature(self, gcov_file: Optional[str] = None, line_counts=None) -> str:
+        # The context kind is part of it: switching to/from structural context rebuilds the shards
+        mode = "structure:" if self.source_index is not None else ""
+        if line_counts is not None:
+            return mode + hashlib.blake2b(line_counts.tobytes(), digest_size=16).hexdigest()
+        st = os.stat(gcov_file)
+        return f"{mode}{st.st_mtime_ns}:{st.st_size}"
+
+    def update(self, base_name: str, gcov_file: Optional[str] = None, line_counts=None,
+               source_path: str = "") -> bool:
+        """
+        Re-index one file if its coverage changed.
+        :param gcov_file: its .gcov report (gcov backend)
+        :param line_counts: its per-line counts and source_path (json/native backends)
+        :return: True if the shard was rebuilt
+        """
+        try:
+            signature = self._signature(gcov_file, line_counts)
+        except OSError:
+            return False
+        with self._lock:
+            old = self._shard(base_name)
+        if old is not None and old.get("signature") == signature:
+            return False
+
+        analyzer = UncoveredBlockAnalyzer(gcov_file or "", context_limit=self.context_limit,
+                                          source_index=self.source_index)
+        if line_counts is not None:
+            analyzer.parse_counts(line_counts, source_path)
+        else:
+            analyzer.parse()
+        functions = _enclosing_functions(analyzer.codes)
+        index_of_line = {line: i for i, line in enumerate(analyzer.line_nums)}
+        structure = None
+        executed: List[str] = []
+        if self.source_index is not None and analyzer.source_path:
+            structure = self.source_index.structure(analyzer.source_path)
+        if structure is not None:
+            for function in structure.functions:
+                lo, hi = index_of_line.get(function[1]), index_of_line.get(function[3])
+                if lo is not None and hi is not None and analyzer.kinds.find(KIND_COVERED, lo, hi + 1) != -1:
+                    executed.append(function[0])
+        old_attempts = [(b["start"], b["end"], b["attempts"]) for b in (old or {}).get("blocks", [])
+                        if b.get("attempts")]
+        blocks = []
+        for b in analyzer.blocks:
+            ub = b["uncovered_block"]
+            start, end = ub[0]["line_num"], ub[-1]["line_num"]
+            context = b["covered_context"] or []
+            # A block that shrank or split keeps the attempts of the block it came from
+            attempts = max((n for s, e, n in old_attempts if s <= end and start <= e), default=0)
+            function = functions[index_of_line[start]]
+            uncovered_guards = 0
+            if structure is not None:
+                enclosing = structure.function_at(start, start)
+                function = enclosing[0] if enclosing else ""
+                uncovered_guards = sum(1 for g in structure.guards(start, end)
+                                       if g[1] in index_of_line
+                                       and analyzer.count_values[index_of_line[g[1]]] == UNCOVERED)
+            blocks.append({
+                "start": start,
+                "end": end,
+                "block_size": b["block_size"],
+                "function": function,
+                "uncovered_guards": uncovered_guards,
+                "context_span": [context[0]["line_num"], context[-1]["line_num"]] if context else None,
+                "attempts": attempts,
+                "covered_context": b["covered_context"],
+                "uncovered_block": ub,
+            })
+        blocks.sort(key=lambda b: b["block_size"], reverse=True)
+        with self._lock:
+            self._shards[base_name] = {"signature": signature, "blocks": blocks, "executed_functions": executed}
+            self._save(base_name)
+        return True
+
+    def refresh(self, gcov_dir: Optional[str] = None, line_counts: Optional[Dict] = None,
+                source_paths: Optional[Dict[str, str]] = None) -> int:
+        """
+        Bring the index up to date after a coverage collection, from every .gcov report in gcov_dir or
+        from the runner's in-memory line_counts/source_paths.
+        :return: number of files re-indexed
+        """
+        rebuilt = 0
+        files = 0
+        if line_counts is not None:
+            for base_name, counts in line_counts.items():
+                files += 1
+                rebuilt += self.update(base_name, line_counts=counts,
+                                       source_path=(source_paths or {}).get(base_name, ""))
+        elif gcov_dir is not None:
+            for gcov_file in glob.glob(os.path.join(gcov_dir, "*.gcov")):
+                files += 1
+                rebuilt += self.update(os.path.basename(gcov_file)[:-len(".gcov")], gcov_file=gcov_file)
+        self.last_update_stats = {"files": files, "rebuilt": rebuilt}
+        print(f"[BlockIndex] {rebuilt}/{files} files re-indexed")
+        return rebuilt
+
+    def update_frontier(self, call_graph) -> int:
+        """
+        Set each indexed block's "distance" from the covered frontier: the calls from an executed function
+        to its enclosing function (0 if that one runs) plus its uncovered guarding conditions.
+        None = reachable only from code nothing executes; blocks outside any function, or in one the call
+        graph does not know (headers, unscanned sources), count as orphan_distance calls away.
+        :return: number of blocks whose distance changed
+        """
+        with self._lock:
+            shards = dict(self._shards)
+        executed = {base: set(shard.get("executed_functions", [])) for base, shard in shards.items()}
+        hops = call_graph.distances(executed)
+        changed = 0
+        for base_name, shard in shards.items():
+            dirty = False
+            for block in shard["blocks"]:
+                node = (base_name, block["function"])
+                if not block["function"]:
+                    distance = call_graph.orphan_distance
+                elif not call_graph.known(node):
+                    distance = call_graph.orphan_distance + block.get("uncovered_guards", 0)
+                else:
+                    calls = hops.get(node)
+                    distance = None if calls is None else calls + block.get("uncovered_guards", 0)
+                if "distance" not in block or block["distance"] != distance:
+                    block["distance"] = distance
+                    dirty = True
+                    changed += 1
+            if dirty:
+                with self._lock:
+                    self._save(base_name)
+        near = sum(1 for shard in shards.values() for b in shard["blocks"] if b["distance"] is not None)
+        total = sum(len(shard["blocks"]) for shard in shards.values())
+        print(f"[BlockIndex] Frontier: {near}/{total} blocks reachable from executed code, {changed} updated")
+        return changed
+
+    def frontier_weights(self, max_distance: int = 2, floor: float = 0.1) -> Dict[str, float]:
+        """
+        Per-file weight for GapSmithSelector: floor + (1 - floor) * share of the file's uncovered lines in
+        blocks at most max_distance from the frontier (files without frontier data are not listed).
+        """
+        weights = {}
+        with self._lock:
+            shards = dict(self._shards)
+        for base_name, shard in shards.items():
+            blocks = [b for b in shard["blocks"] if "distance" in b]
+            total = sum(b["block_size"] for b in blocks)
+            if not total:
+                continue
+            near = sum(b["block_size"] for b in blocks if b["distance"] is not None and b["distance"] <= max_distance)
+            weights[base_name] = floor + (1.0 - floor) * near / total
+        return weights
+
+    @staticmethod
+    def _priority(block: Dict):
+        # Larger and nearer first; blocks only reachable from unexecuted code last
+        if "distance" not in block:
+            return 0, -block["block_size"]
+        if block["distance"] is None:
+            return 1, -block["block_size"]
+        return 0, -block["block_size"] / (1 + block["distance"])
+
+    def blocks(self, base_name: str) -> List[Dict]:
+        """Indexed uncovered blocks of base_name, largest first."""
+        with self._lock:
+            shard = self._shard(base_name)
+        return shard["blocks"] if shard else []
+
+    def best_block(self, base_name: str, exclude_lines: Optional[Set[int]] = None) -> Optional[Dict]:
+        """
+        Uncovered block of base_name that has none of exclude_lines (e.g. lines hit since the last
+        collection) and has not used up max_attempts: the largest one, or with frontier distances the
+        one with the best size / (1 + distance).
+        """
+        candidates = (block for block in self.blocks(base_name)
+                      if not (self.max_attempts is not None and block["attempts"] >= self.max_attempts)
+                      and not (exclude_lines and any(e["line_num"] in exclude_lines for e in block["uncovered_block"])))
+        return min(candidates, key=self._priority, default=None)
+
+    def record_attempt(self, base_name: str, block: Dict, covered: bool):
+        """Count one generation round aimed at block (a covered block disappears at the next update)."""
+        with self._lock:
+            shard = self._shard(base_name)
+            if shard is None:
+                return
+            for b in shard["blocks"]:
+                if b["start"] == block["start"] and b["end"] == block["end"]:
+                    b["attempts"] += 1
+                    b["last_covered"] = covered
+                    break
+            self._save(base_name)
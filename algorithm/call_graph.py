@@ -0,0 +1,123 @@
+import glob
+import heapq
+import os
+from typing import Dict, List, Optional, Set, Tuple
+
+from algorithm.source_index import SourceIndex
+
+Node = Tuple[str, str]  # (source basename, function name)
+
+
+class CallGraph:
+    """
+    Static call graph of the compiler sources, assembled from the SourceIndex structures (scanned once per
+    file version and cached on disk). distances() gives, from the functions already executed (the covered
+    frontier), how many calls away every other function is.
+    Calls are matched by name: a same-file definition wins (static functions), and qualified definitions
+    such as pass_ccp::execute also answer to their last component. Indirect calls (target hooks, virtual
+    pass methods, callbacks) are invisible, so functions without any known caller are treated as entry
+    points orphan_distance calls away instead of unreachable.
+    With build_dirs, the graph covers the instrumented translation units only (one per .gcno), including
+    the sources generated into the build tree (insn-*.cc, *-match.cc); tests and tools in the source tree
+    are left out.
+    """
+    def __init__(self, source_index: SourceIndex, orphan_distance: int = 3, build_dirs: Optional[List[str]] = None):
+        """
+        :param source_index: index of the compiler sources
+        :param orphan_distance: distance given to functions that nothing calls directly
+        :param build_dirs: build directories holding the .gcno files (GcovRunner source_dirs); None = every
+                           source under the source_index's source_roots
+        """
+        self.source_index = source_index
+        self.orphan_distance = orphan_distance
+        self.build_dirs = build_dirs
+        self.edges: Dict[Node, List[Node]] = {}
+        self.orphans: Set[Node] = set()
+        self._built_from: Optional[List[int]] = None
+
+    def _units(self) -> List[str]:
+        """Sources of the translation units: a generated one in the build tree, else found via the source index."""
+        if self.build_dirs is None:
+            return self.source_index.sources()
+        units = set()
+        for build_dir in self.build_dirs:
+            for gcno in glob.glob(os.path.join(build_dir, "*.gcno")):
+                stem = os.path.splitext(gcno)[0]
+                for ext in (".cc", ".c"):
+                    path = self.source_index.resolve(stem + ext)
+                    if path is not None:
+                        units.add(path)
+                        break
+        return sorted(units)
+
+    def build(self) -> bool:
+        """
+        (Re)build the graph if any source structure changed since the last build.
+        :return: True if rebuilt
+        """
+        structures = []
+        for path in self._units():
+            structure = self.source_index.structure(path)
+            if structure is not None:
+                structures.append((os.path.basename(path), structure))
+        stamp = [id(s) for _, s in structures]
+        if stamp == self._built_from:
+            return False
+
+        calls: Dict[Node, Set[str]] = {}
+        by_name: Dict[str, List[Node]] = {}
+        for base, structure in structures:
+            for function in structure.functions:
+                node = (base, function[0])
+                calls.setdefault(node, set()).update(function[4])
+                by_name.setdefault(function[0], []).append(node)
+                short = function[0].rsplit("::", 1)[-1]
+                if short != function[0]:
+                    by_name.setdefault(short, []).append(node)
+
+        self.edges = {}
+        called: Set[Node] = set()
+        for node, names in calls.items():
+            targets = []
+            for name in names:
+                definitions = by_name.get(name)
+                if not definitions:
+                    continue  # library function or macro
+                local = [d for d in definitions if d[0] == node[0]]
+                targets.extend(local or definitions)
+            self.edges[node] = sorted(set(targets) - {node})
+            called.update(self.edges[node])
+        self.orphans = set(calls) - called
+        self._built_from = stamp
+        print(f"[CallGraph] {len(self.edges)} functions, {sum(len(t) for t in self.edges.values())} call edges, "
+              f"{len(self.orphans)} without direct callers")
+        return True
+
+    def known(self, node: Node) -> bool:
+        """Whether the function is defined in the scanned sources (functions of headers, for instance, are not)."""
+        return node in self.edges
+
+    def distances(self, executed: Dict[str, Set[str]]) -> Dict[Node, int]:
+        """
+        Calls needed to reach each function from an executed one.
+        :param executed: {source basename: names of the functions with covered lines}
+        :return: {(basename, function): distance}, 0 for executed functions; graph functions missing from the
+                 result are only reachable from code nothing executes (see known())
+        """
+        self.build()
+        dist: Dict[Node, int] = {}
+        heap: List[Tuple[int, Node]] = []
+        for base, names in executed.items():
+            for name in names:
+                heap.append((0, (base, name)))
+        heap.extend((self.orphan_distance, node) for node in self.orphans)
+        heapq.heapify(heap)
+        while heap:
+            d, node = heapq.heappop(heap)
+            if node in dist:
+                continue
+            dist[node] = d
+            for callee in self.edges.get(node, ()):
+                if callee not in dist:
+                    heapq.heappush(heap, (d + 1, callee))
+        return dist
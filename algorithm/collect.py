@@ -1,80 +1,436 @@
+import hashlib
+import json
 import os
+import shutil
+import struct
 import subprocess
 import sys
 import re
-from typing import List
+import tempfile
+import time
+from array import array
+from concurrent.futures import ProcessPoolExecutor, ThreadPoolExecutor
+from typing import Dict, List, Optional, Tuple
+
+from algorithm.gcov_json import iter_gcov_json, json_line_counts
+from algorithm.gcov_reader import format_gcov, read_translation_unit, summarize_counts
+
+
+def _read_native_job(gcno_path: str, gcda_path: str):
+    """
+    Read one translation unit with the native reader (module level so it can run in a process pool)
+    :return: (result of read_translation_unit or None, elapsed seconds, error message or None)
+    """
+    start = time.time()
+    try:
+        return read_translation_unit(gcno_path, gcda_path), time.time() - start, None
+    except Exception as e:
+        return None, time.time() - start, f"{type(e).__name__}: {e}"
+
 
 class GcovRunner:
     """
     Gcov tool for collecting coverage data from target directories
     """
-    def __init__(self, source_dirs: List[str], target_dirs: List[str], output_dir: str = ".", gcov_path: str = "gcov-13"):
+    OBJECT_SUMMARY_TAG = 0xa1000000
+    def __init__(self, source_dirs: List[str], target_dirs: List[str], output_dir: str = ".", gcov_path: str = "gcov-13",
+                 max_workers: Optional[int] = None, incremental: bool = False, manifest_path: Optional[str] = None,
+                 backend: str = "gcov", export_gcov: bool = True):
         """
         :param source_dirs: .gcda/.gcno files directory
         :param target_dirs: source code directories
         :param output_dir: output coverage txt files directory
         :param gcov_path: path to gcov executable (default: gcov-13)
+        :param max_workers: number of concurrent gcov processes (default: os.cpu_count(), 1 = serial)
+        :param incremental: only run gcov for translation units whose .gcda/.gcno changed since the last run,
+                            reusing the cached report lines and .gcov files for the rest
+        :param manifest_path: persistent manifest of .gcda states (default: output_dir/.gcov_manifest.json)
+        :param backend: "gcov" runs the gcov executable and writes .gcov files;
+                        "json" streams `gcov --json-format --stdout` into line_counts;
+                        "native" reads .gcno/.gcda in-process into line_counts
+        :param export_gcov: json/native backends only, also write .gcov text files into the current directory
         """
+        if backend not in ("gcov", "json", "native"):
+            raise ValueError(f"unknown backend: {backend}")
         if len(source_dirs) != len(target_dirs):
             raise ValueError("source_dirs and target_dirs must have the same length")
         self.source_dirs = source_dirs
         self.target_dirs = target_dirs
         self.output_dir = output_dir
         self.gcov_path = gcov_path
+        self.max_workers = max(1, max_workers or os.cpu_count() or 1)
         self.file_pattern = re.compile(r"File '(.*\.cc)'")
         self.coverage_pattern = re.compile(r"Lines executed:([\d.]+)% of (\d+)")
         self.coverage_results = [] 
         self.processed_files = set()
+        self.last_run_stats = {}
+        self.incremental = incremental
+        self.manifest_path = manifest_path or os.path.join(output_dir, ".gcov_manifest.json")
+        self.manifest: Dict[str, Dict] = {}
+        self.reused_files = 0
+        self.backend = backend
+        self.export_gcov = export_gcov
+        self.line_counts: Dict[str, array] = {}  # {source basename: per-line counts, -1 = not executable}
+        self.source_paths: Dict[str, str] = {}  # {source basename: readable source path}
+        self._tu_sources: Dict[str, List[str]] = {}
+
+    def _collect_jobs(self, tgt_dir: str) -> List[Tuple[str, str]]:
+        """
+        List (cc_path, file_name) pairs under tgt_dir in os.walk order, skipping already processed files
+        """
+        jobs = []
+        for root, _, files in os.walk(tgt_dir):
+            for file in files:
+                if file.endswith('.cc'):
+                    cc_path = os.path.join(root, file)
+                    abs_path = os.path.abspath(cc_path)
+                    if abs_path in self.processed_files:
+                        continue
+                    self.processed_files.add(abs_path)
+                    jobs.append((cc_path, file))
+        return jobs
+
+    def _parse_summary(self, stdout: str, file: str):
+        """
+        Parse gcov stdout, return (current_file, coverage, total_lines) of the summary for file, or None
+        """
+        current_file = None
+        for line in stdout.splitlines():
+            file_match = self.file_pattern.search(line)
+            if file_match:
+                current_file = file_match.group(1)
+            cov_match = self.coverage_pattern.search(line)
+            if cov_match and current_file and current_file.endswith(file):
+                return current_file, float(cov_match.group(1)), int(cov_match.group(2))
+        return None
+
+    def _run_gcov(self, src_dir: str, cc_path: str, file: str, cwd: str):
+        """
+        Execute gcov for one file in cwd
+        :return: (summary or None, elapsed seconds, error message or None)
+        """
+        start = time.time()
+        try:
+            proc = subprocess.run(
+                [self.gcov_path, '-o', src_dir, cc_path],
+                stdout=subprocess.PIPE,
+                stderr=subprocess.STDOUT,
+                encoding='utf-8',
+                cwd=cwd
+            )
+            return self._parse_summary(proc.stdout, file), time.time() - start, None
+        except Exception as e:
+            return None, time.time() - start, str(e)
+
+    def _run_gcov_isolated(self, src_dir: str, cc_path: str, file: str):
+        """
+        Execute gcov for one file in a private scratch directory, so that concurrent
+        gcov processes never write the same (header) .gcov file at the same time
+        :return: (scratch_dir, summary or None, elapsed seconds, error message or None)
+        """
+        scratch = tempfile.mkdtemp(prefix=".gcov_worker_", dir=os.getcwd())
+        summary, elapsed, err = self._run_gcov(os.path.abspath(src_dir), os.path.abspath(cc_path), file, scratch)
+        return scratch, summary, elapsed, err
+
+    def _run_isolated(self, src_dir: str, jobs: List[Tuple[str, str]]):
+        """
+        Execute gcov for all jobs on a bounded pool of gcov processes.
+        Results are consumed in submission order and the produced .gcov files are moved
+        into the current directory in that order, which reproduces the serial output
+        (including "last writer wins" for shared header .gcov files).
+        :return: generator of (summary, elapsed, err, produced .gcov file names)
+        """
+        cwd = os.getcwd()
+        with ThreadPoolExecutor(max_workers=self.max_workers) as executor:
+            futures = [executor.submit(self._run_gcov_isolated, src_dir, cc_path, file) for cc_path, file in jobs]
+            for future in futures:
+                scratch, summary, elapsed, err = future.result()
+                names = []
+                try:
+                    for name in os.listdir(scratch):
+                        os.replace(os.path.join(scratch, name), os.path.join(cwd, name))
+                        names.append(name)
+                finally:
+                    shutil.rmtree(scratch, ignore_errors=True)
+                yield summary, elapsed, err, names
+
+    def _execute(self, src_dir: str, jobs: List[Tuple[str, str]]):
+        """
+        Dispatch jobs to the configured backend
+        :return: generator of (summary, elapsed, err, produced .gcov file names) in job order
+        """
+        if self.backend == "native":
+            return self._run_native(src_dir, jobs)
+        if self.backend == "json":
+            return self._run_json(src_dir, jobs)
+        return self._run_isolated(src_dir, jobs)
+
+    def _ingest(self, cc_path: str, file: str, counts_by_source: Dict[str, Tuple[str, array]],
+                graph: str = "", data: str = "", runs: int = 0):
+        """
+        Store the in-memory line counts of one translation unit and derive its summary.
+        .gcov text is only written when export_gcov is set.
+        :param counts_by_source: {source name: (readable source path, per-line counts)}
+        :return: (summary or None, produced .gcov file names)
+        """
+        summary = None
+        names = []
+        sources = []
+        for source, (source_path, counts) in counts_by_source.items():
+            name = os.path.basename(source)
+            self.line_counts[name] = counts
+            self.source_paths[name] = source_path
+            sources.append(name)
+            if summary is None and source.endswith(file):
+                coverage, total_lines = summarize_counts(counts)
+                summary = (source, round(coverage, 2), total_lines)
+            if self.export_gcov:
+                with open(name + ".gcov", 'w', encoding='utf-8') as f:
+                    f.write(format_gcov(source, counts, source_path, graph=graph, data=data, runs=runs))
+                names.append(name + ".gcov")
+        self._tu_sources[os.path.abspath(cc_path)] = sources
+        return summary, names
+
+    def _run_native(self, src_dir: str, jobs: List[Tuple[str, str]]):
+        """
+        Read .gcno/.gcda of each job in-process (on a process pool when max_workers > 1).
+        :return: generator of (summary, elapsed, err, produced .gcov file names) in job order
+        """
+        paths = []
+        for cc_path, file in jobs:
+            stem = os.path.join(src_dir, os.path.splitext(file)[0])
+            paths.append((stem + ".gcno", stem + ".gcda"))
+        if self.max_workers > 1 and len(jobs) > 1:
+            executor = ProcessPoolExecutor(max_workers=self.max_workers)
+            results = executor.map(_read_native_job, *zip(*paths), chunksize=8)
+        else:
+            executor = None
+            results = (_read_native_job(gcno, gcda) for gcno, gcda in paths)
+        try:
+            for (cc_path, file), (gcno, gcda), (tu, elapsed, err) in zip(jobs, paths, results):
+                if err is not None:
+                    yield None, elapsed, err, []
+                    continue
+                tu_cwd, runs, counts = tu
+                counts_by_source = {
+                    source: (source if os.path.isabs(source) else os.path.join(tu_cwd, source), c)
+                    for source, c in counts.items()
+                }
+                summary, names = self._ingest(cc_path, file, counts_by_source, graph=gcno, data=gcda, runs=runs)
+                yield summary, elapsed, None, names
+        finally:
+            if executor is not None:
+                executor.shutdown()
+
+    def _run_gcov_json(self, src_dir: str, cc_path: str):
+        """
+        Execute `gcov --json-format --stdout` for one file and stream its output into line counts.
+        Nothing is written to disk, so no working directory is needed.
+        :return: ({source name: (readable source path, counts)} or None, elapsed seconds, error message or None)
+        """
+        start = time.time()
+        try:
+            proc = subprocess.Popen(
+                [self.gcov_path, '--json-format', '--stdout', '-o', src_dir, cc_path],
+                stdout=subprocess.PIPE,
+                stderr=subprocess.DEVNULL,
+                encoding='utf-8'
+            )
+            counts_by_source: Dict[str, Tuple[str, array]] = {}
+            with proc.stdout:
+                for doc in iter_gcov_json(proc.stdout):
+                    counts_by_source.update(json_line_counts(doc))
+            proc.wait()
+            return counts_by_source, time.time() - start, None
+        except Exception as e:
+            return None, time.time() - start, str(e)
+
+    def _run_json(self, src_dir: str, jobs: List[Tuple[str, str]]):
+        """
+        Execute gcov in JSON mode for all jobs on a bounded pool of gcov processes.
+        :return: generator of (summary, elapsed, err, produced .gcov file names) in job order
+        """
+        with ThreadPoolExecutor(max_workers=self.max_workers) as executor:
+            futures = [executor.submit(self._run_gcov_json, src_dir, cc_path) for cc_path, _ in jobs]
+            for (cc_path, file), future in zip(jobs, futures):
+                counts_by_source, elapsed, err = future.result()
+                if err is not None:
+                    yield None, elapsed, err, []
+                    continue
+                summary, names = self._ingest(cc_path, file, counts_by_source)
+                yield summary, elapsed, None, names
+
+    @staticmethod
+    def _file_state(path: str, old: Optional[Dict]) -> Optional[Dict]:
+        """
+        Return {"mtime_ns", "size", "sha1"} of a counter/notes file, or None if it does not exist.
+        The file is only hashed when its mtime or size differs from the old state.
+        """
+        try:
+            st = os.stat(path)
+        except OSError:
+            return None
+        if old and old.get("mtime_ns") == st.st_mtime_ns and old.get("size") == st.st_size:
+            return old
+        with open(path, 'rb') as f:
+            data = f.read()
+        return {"mtime_ns": st.st_mtime_ns, "size": st.st_size, "sha1": GcovRunner._counters_digest(data)}
+
+    @staticmethod
+    def _counters_digest(data: bytes) -> str:
+        """
+        Hash a .gcda/.gcno file, skipping the object summary record of .gcda files.
+        libgcov rewrites every .gcda of the executable at exit and bumps the "runs"
+        field even when no counter changed, so hashing the raw bytes would mark all
+        translation units as changed after every compile.
+        Layout (GCC >= 12): magic version stamp checksum {tag length(bytes, <0 = all-zero counters) payload}*
+        """
+        digest = hashlib.sha1()
+        if len(data) < 16 or data[:4] not in (b'adcg', b'gcda'):
+            digest.update(data)
+            return digest.hexdigest()
+        fmt = '<ii' if data[:4] == b'adcg' else '>ii'
+        digest.update(data[:16])
+        pos = 16
+        while pos + 8 <= len(data):
+            tag, length = struct.unpack_from(fmt, data, pos)
+            size = max(length, 0)
+            if (tag & 0xffffffff) != GcovRunner.OBJECT_SUMMARY_TAG:
+                digest.update(data[pos:pos + 8 + size])
+            pos += 8 + size
+        digest.update(data[pos:])
+        return digest.hexdigest()
+
+    @staticmethod
+    def _same_content(old: Optional[Dict], new: Optional[Dict]) -> bool:
+        if old is None or new is None:
+            return old is new
+        return old.get("size") == new.get("size") and old.get("sha1") == new.get("sha1")
+
+    def load_manifest(self):
+        """
+        Load the persistent .gcda manifest: {abs_cc_path: {"gcda", "gcno", "summary", "gcov_files"}}
+        """
+        self.manifest = {}
+        if not os.path.isfile(self.manifest_path):
+            return
+        try:
+            with open(self.manifest_path, 'r', encoding='utf-8') as f:
+                self.manifest = json.load(f).get("entries", {})
+        except (OSError, ValueError) as e:
+            print(f"[GcovRunner] ignoring unreadable manifest {self.manifest_path}: {e}")
+
+    def save_manifest(self):
+        tmp_path = self.manifest_path + ".tmp"
+        with open(tmp_path, 'w', encoding='utf-8') as f:
+            json.dump({"version": 1, "entries": self.manifest}, f)
+        os.replace(tmp_path, self.manifest_path)
+
+    def _run_incremental(self, src_dir: str, jobs: List[Tuple[str, str]]):
+        """
+        Execute gcov only for translation units whose .gcda/.gcno changed since the last collection.
+        Unchanged units reuse the cached summary as long as their .gcov files are still present.
+        :return: generator of (summary, elapsed, err) in job order
+        """
+        cwd = os.getcwd()
+        states = []
+        stale = []
+        for cc_path, file in jobs:
+            key = os.path.abspath(cc_path)
+            old = self.manifest.get(key) or {}
+            stem = os.path.join(src_dir, os.path.splitext(file)[0])
+            gcda = self._file_state(stem + ".gcda", old.get("gcda"))
+            gcno = self._file_state(stem + ".gcno", old.get("gcno"))
+            reusable = (
+                "summary" in old
+                and all(name in self.line_counts for name in old.get("sources", []))
+                and self._same_content(old.get("gcda"), gcda)
+                and self._same_content(old.get("gcno"), gcno)
+                and all(os.path.isfile(os.path.join(cwd, name)) for name in old.get("gcov_files", []))
+            )
+            states.append((key, gcda, gcno, reusable))
+            if not reusable:
+                stale.append((cc_path, file))
+        fresh = self._execute(src_dir, stale)
+        for key, gcda, gcno, reusable in states:
+            if reusable:
+                entry = self.manifest[key]
+                entry["gcda"], entry["gcno"] = gcda, gcno
+                self.reused_files += 1
+                summary = entry["summary"]
+                yield (tuple(summary) if summary else None), 0.0, None
+                continue
+            summary, elapsed, err, names = next(fresh)
+            if err is None:
+                self.manifest[key] = {
+                    "gcda": gcda,
+                    "gcno": gcno,
+                    "summary": list(summary) if summary else None,
+                    "gcov_files": names,
+                    "sources": self._tu_sources.pop(key, []),
+                }
+            else:
+                self.manifest.pop(key, None)
+            yield summary, elapsed, err
 
     def run(self):
         """
         Main execution function:
-        - Execute gcov for each file
+        - Execute gcov (or the native .gcno/.gcda reader) for each file, serially or on a bounded process pool,
+          or only for changed translation units in incremental mode
         - Parse output and record coverage
+        - Record wall-clock time and speedup over the summed per-file gcov time
         """
         self.coverage_results.clear()
         self.processed_files.clear()  
+        self.reused_files = 0
+        if self.incremental:
+            self.load_manifest()
+        start = time.time()
+        gcov_time = 0.0
+        file_count = 0
         for src_dir, tgt_dir in zip(self.source_dirs, self.target_dirs):
             if not os.path.isdir(src_dir) or not os.path.isdir(tgt_dir):
                 print(f"path not found: {src_dir} or {tgt_dir}")
                 continue
             txt_name = os.path.basename(os.path.normpath(tgt_dir)) + ".txt"
             output_path = os.path.join(self.output_dir, txt_name)
+            jobs = self._collect_jobs(tgt_dir)
+            if self.incremental:
+                results = self._run_incremental(src_dir, jobs)
+            elif self.backend != "gcov" or self.max_workers > 1:
+                results = (r[:3] for r in self._execute(src_dir, jobs))
+            else:
+                results = (self._run_gcov(src_dir, cc_path, file, os.getcwd()) for cc_path, file in jobs)
             with open(output_path, 'w') as out:
-                for root, _, files in os.walk(tgt_dir):
-                    for file in files:
-                        if file.endswith('.cc'):
-                            cc_path = os.path.join(root, file)
-                            abs_path = os.path.abspath(cc_path)
-                            if abs_path in self.processed_files:
-                                continue
-                            self.processed_files.add(abs_path)
-                            try:
-                                proc = subprocess.run(
-                                    [self.gcov_path, '-o', src_dir, cc_path],
-                                    stdout=subprocess.PIPE,
-                                    stderr=subprocess.STDOUT,
-                                    encoding='utf-8',
-                                    cwd=os.getcwd()
-                                )
-                                current_file = None
-                                for line in proc.stdout.splitlines():
-                                    file_match = self.file_pattern.search(line)
-                                    if file_match:
-                                        current_file = file_match.group(1)
-                                    cov_match = self.coverage_pattern.search(line)                             
-                                    if cov_match and current_file and current_file.endswith(file): 
-                                        coverage = float(cov_match.group(1))
-                                        total_lines = int(cov_match.group(2))
-                                        out.write(f"{current_file}: {coverage:.2f}% of {total_lines} lines\n")
-                                        self.coverage_results.append((
-                                            os.path.basename(current_file),
-                                            coverage,
-                                            total_lines
-                                        ))
-                                        break
-                            except Exception as e:
-                                print(f" {cc_path} : {e}")
+                for (cc_path, _), (summary, elapsed, err) in zip(jobs, results):
+                    gcov_time += elapsed
+                    file_count += 1
+                    if err is not None:
+                        print(f" {cc_path} : {err}")
+                        continue
+                    if summary is None:
+                        continue
+                    current_file, coverage, total_lines = summary
+                    out.write(f"{current_file}: {coverage:.2f}% of {total_lines} lines\n")
+                    self.coverage_results.append((
+                        os.path.basename(current_file),
+                        coverage,
+                        total_lines
+                    ))
+        if self.incremental:
+            self.save_manifest()
+        wall_time = time.time() - start
+        self.last_run_stats = {
+            "files": file_count,
+            "reused": self.reused_files,
+            "workers": self.max_workers,
+            "wall_time": wall_time,
+            "gcov_time": gcov_time,
+            "speedup": gcov_time / wall_time if wall_time > 0 else 1.0,
+        }
+        print(f"[GcovRunner] {file_count} files ({self.reused_files} reused) with {self.max_workers} workers in {wall_time:.2f}s "
+              f"(gcov time {gcov_time:.2f}s, speedup {self.last_run_stats['speedup']:.2f}x)")
 
     def compute_average_coverage(self):
         """
@@ -0,0 +1,178 @@
+import hashlib
+import json
+import os
+import re
+import shlex
+import shutil
+import subprocess
+import tempfile
+import threading
+import time
+from pathlib import Path
+from typing import Callable, Dict, Optional, Tuple
+
+# String and character literals are kept verbatim; any other whitespace run collapses to one space
+_NORMALIZE_RE = re.compile(r'("(?:\\.|[^"\\\n])*"|\'(?:\\.|[^\'\\\n])*\')|\s+')
+# Stands for the program path (without suffix) in stored error messages
+_PROGRAM_TOKEN = "@GAPSMITH_PROGRAM@"
+# Results that depend on the machine's load rather than on the program
+_UNCACHEABLE_ERRORS = ("Compilation error: Timeout", "Compilation error: fork server failed",
+                       "Compilation error: cc1 killed by signal")
+
+
+def normalize_source(text: str) -> str:
+    """Collapse whitespace outside literals, so layout-only differences map to the same key."""
+    return _NORMALIZE_RE.sub(lambda m: m.group(1) or " ", text).strip()
+
+
+def normalize_raw_source(text: str) -> str:
+    """
+    normalize_source per line, dropping blank lines: unpreprocessed code keeps its line structure, which
+    preprocessor directives depend on.
+    """
+    lines = (normalize_source(line) for line in text.split("\n"))
+    return "\n".join(line for line in lines if line)
+
+
+class CompileCache:
+    """
+    compile_fn for CompileScheduler that skips programs it has already compiled.
+    The key hashes the normalized source, the options, the stage and the compiler binary (path, size and
+    mtime), so identical or whitespace-only-different programs compile once. The source is hashed as
+    written (generated programs only include system headers); with a preprocess_gcc it is preprocessed
+    first, which also merges programs differing only in comments or macro spelling. A hit
+    returns the stored (success, error) and produces no counters, which would not change anyway, as long
+    as the profile the first compile counted into is still alive: entries are JSON files under a per-run
+    cache_dir/run_*/<2 hex digits>/, removed by close(), so a run on reset profiles recompiles everything.
+    The "preprocess" stage is never cached, since its .i output is needed.
+    """
+    def __init__(self, compile_fn: Callable[..., Tuple[bool, Optional[str]]], cache_dir: str,
+                 preprocess_gcc: Optional[str] = None):
+        """
+        :param compile_fn: compile_program-compatible function run on a miss
+        :param cache_dir: parent of the per-run entry directories
+        :param preprocess_gcc: compiler used for `-E` before hashing (default: none, the raw source is hashed);
+                               if instrumented, its counters go to a scratch GCOV_PREFIX so preprocessing never
+                               shows up as coverage
+        """
+        self.compile_fn = compile_fn
+        os.makedirs(cache_dir, exist_ok=True)
+        self.cache_dir = tempfile.mkdtemp(prefix="run_", dir=os.path.abspath(cache_dir))
+        self.preprocess_gcc = preprocess_gcc
+        self.scratch_prefix = os.path.join(self.cache_dir, ".preprocess_profile")
+        os.makedirs(self.scratch_prefix, exist_ok=True)
+        self._identities: Dict[str, str] = {}
+        self._lock = threading.Lock()
+        self.started = time.time()
+        self.stats = {"hits": 0, "misses": 0, "uncacheable": 0, "saved_time": 0.0}
+
+    def _compiler_identity(self, gcc_path: str) -> str:
+        identity = self._identities.get(gcc_path)
+        if identity is None:
+            try:
+                real = os.path.realpath(gcc_path)
+                st = os.stat(real)
+                identity = f"{real}:{st.st_size}:{st.st_mtime_ns}"
+            except OSError:
+                identity = gcc_path
+            self._identities[gcc_path] = identity
+        return identity
+
+    def _preprocess(self, program_path: str, options: str, timeout_sec: int,
+                    env: Optional[Dict[str, str]]) -> Optional[str]:
+        env = dict(env if env is not None else os.environ)
+        env["GCOV_PREFIX"] = self.scratch_prefix
+        cmd = [self.preprocess_gcc, "-E", "-P"] + shlex.split(options) + [program_path]
+        try:
+            res = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8",
+                                 errors="replace", timeout=timeout_sec, env=env)
+        except (OSError, ValueError, subprocess.TimeoutExpired):
+            return None
+        return res.stdout if res.returncode == 0 else None
+
+    def key(self, program_path: str, compile_options: Optional[str], gcc_path: str, timeout_sec: int = 60,
+            env: Optional[Dict[str, str]] = None, stage: Optional[str] = None) -> Optional[str]:
+        """
+        Cache key of a compile.
+        :return: hex digest, or None if the program cannot be read or preprocessed (the compile reports why)
+        """
+        options = compile_options.strip() if compile_options else "-O3"
+        if self.preprocess_gcc:
+            text = self._preprocess(program_path, options, timeout_sec, env)
+            normalized = normalize_source(text) if text is not None else None
+        else:
+            try:
+                normalized = normalize_raw_source(Path(program_path).read_text(encoding="utf-8", errors="replace"))
+            except OSError:
+                normalized = None
+        if normalized is None:
+            return None
+        h = hashlib.sha256()
+        # "raw:" keeps raw-source and preprocessed keys apart
+        for part in (self._compiler_identity(gcc_path), options, stage or "",
+                     ("pre:" if self.preprocess_gcc else "raw:") + normalized):
+            h.update(part.encode("utf-8", "surrogateescape"))
+            h.update(b"\0")
+        return h.hexdigest()
+
+    def _entry_path(self, key: str) -> Path:
+        return Path(self.cache_dir) / key[:2] / f"{key}.json"
+
+    def _load(self, key: str) -> Optional[dict]:
+        try:
+            return json.loads(self._entry_path(key).read_text(encoding="utf-8"))
+        except (OSError, ValueError):
+            return None
+
+    def _store(self, key: str, entry: dict):
+        path = self._entry_path(key)
+        path.parent.mkdir(parents=True, exist_ok=True)
+        tmp = path.with_name(f"{path.name}.{os.getpid()}.{threading.get_ident()}")
+        tmp.write_text(json.dumps(entry), encoding="utf-8")
+        os.replace(tmp, path)
+
+    def __call__(self, program_path: str, compile_options: Optional[str] = None, gcc_path: Optional[str] = None,
+                 timeout_sec: int = 60, env: Optional[Dict[str, str]] = None,
+                 stage: Optional[str] = None) -> Tuple[bool, Optional[str]]:
+        gcc_path = gcc_path or "gcc-build/bin/gcc"
+        if stage == "preprocess":
+            return self.compile_fn(program_path, compile_options, gcc_path, timeout_sec, env, stage=stage)
+        stem = str(Path(program_path).with_suffix(""))
+        key = self.key(program_path, compile_options, gcc_path, timeout_sec, env, stage)
+        entry = self._load(key) if key is not None else None
+        if entry is not None:
+            with self._lock:
+                self.stats["hits"] += 1
+                self.stats["saved_time"] += entry.get("seconds", 0.0)
+            error = entry.get("error")
+            return entry.get("success", False), error.replace(_PROGRAM_TOKEN, stem) if error else error
+
+        start = time.time()
+        success, error = self.compile_fn(program_path, compile_options, gcc_path, timeout_sec, env, stage=stage)
+        seconds = time.time() - start
+        cacheable = key is not None and not (error and error.startswith(_UNCACHEABLE_ERRORS))
+        with self._lock:
+            self.stats["misses" if cacheable else "uncacheable"] += 1
+        if cacheable:
+            try:
+                self._store(key, {"success": success, "error": error.replace(stem, _PROGRAM_TOKEN) if error else error,
+                                  "seconds": seconds, "options": compile_options, "stage": stage,
+                                  "created": time.time()})
+            except OSError:
+                pass
+        return success, error
+
+    def close(self):
+        """Remove this run's entries (their counters live only in this run's profiles)."""
+        shutil.rmtree(self.cache_dir, ignore_errors=True)
+
+    def summary(self) -> str:
+        """Hit rate and the compiles (and compile time) saved per hour of running."""
+        with self._lock:
+            hits, misses, uncacheable = self.stats["hits"], self.stats["misses"], self.stats["uncacheable"]
+            saved = self.stats["saved_time"]
+        total = hits + misses + uncacheable
+        hours = max(time.time() - self.started, 1.0) / 3600
+        rate = 100.0 * hits / total if total else 0.0
+        return (f"hits {hits}/{total} ({rate:.1f}%), {hits / hours:.0f} compiles/h saved, "
+                f"{saved:.1f}s compile time saved")
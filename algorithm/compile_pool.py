@@ -0,0 +1,228 @@
+import os
+import queue
+import shutil
+import subprocess
+import tempfile
+import time
+from concurrent.futures import ProcessPoolExecutor, ThreadPoolExecutor
+from pathlib import Path
+from typing import Callable, Dict, List, Optional, Tuple
+
+from algorithm.gcov_merge import merge_gcda_files
+
+
+class CompileScheduler:
+    """
+    Compile a batch of programs concurrently with an instrumented compiler.
+    Every worker slot owns a GCOV_PREFIX directory, so the compiler processes never contend on the
+    same .gcda files; after the batch, the per-worker profiles are folded back into the real .gcda
+    files (native counter merge or gcov-tool) before coverage is collected.
+    """
+    def __init__(self, compile_fn: Callable[..., Tuple[bool, Optional[str]]], max_workers: Optional[int] = None,
+                 timeout_sec: int = 60, profile_dir: Optional[str] = None, gcov_tool_path: str = "gcov-tool-13",
+                 profile_root: Optional[str] = None, merge_backend: str = "native", per_program_profiles: bool = False,
+                 fold_root: Optional[str] = None):
+        """
+        :param compile_fn: compile_fn(program_path, compile_options, gcc_path, timeout_sec, env, stage=None)
+                           -> (success, error)
+        :param max_workers: number of concurrent compiler processes (default: os.cpu_count(), 1 = serial)
+        :param timeout_sec: per-program compilation timeout in seconds
+        :param profile_dir: root of the per-worker GCOV_PREFIX directories (default: a new temp directory)
+        :param gcov_tool_path: path to gcov-tool, used to merge worker profiles into existing .gcda files
+        :param profile_root: directory containing all .gcda files of the compiler; its leading path components
+                             are removed with GCOV_PREFIX_STRIP so worker trees mirror it (default: "/", nothing stripped)
+        :param merge_backend: "native" sums arc counters in-process (falling back to gcov-tool for files it
+                              cannot merge), "gcov-tool" always runs gcov-tool merge
+        :param per_program_profiles: give every compile its own empty prefix instead of a per-worker one, so the
+                                     counters of each program can be inspected before folding (coverage attribution)
+        :param fold_root: tree the worker profiles are folded into (default: profile_root), e.g. a RAM working copy
+                          of it (see scratch.py)
+        """
+        if merge_backend not in ("native", "gcov-tool"):
+            raise ValueError(f"unknown merge backend: {merge_backend}")
+        self.compile_fn = compile_fn
+        self.max_workers = max(1, max_workers or os.cpu_count() or 1)
+        self.timeout_sec = timeout_sec
+        self.profile_dir = profile_dir or tempfile.mkdtemp(prefix=".compile_pool_")
+        self.gcov_tool_path = gcov_tool_path
+        self.profile_root = os.path.abspath(profile_root) if profile_root else os.sep
+        self.prefix_strip = len(Path(self.profile_root).parts) - 1
+        self.fold_root = os.path.abspath(fold_root) if fold_root else self.profile_root
+        self.merge_backend = merge_backend
+        self.per_program_profiles = per_program_profiles
+        self.last_run_stats: Dict[str, float] = {}
+
+        self._slots: "queue.Queue[str]" = queue.Queue()
+        for i in range(self.max_workers):
+            slot = os.path.join(self.profile_dir, f"worker_{i}")
+            os.makedirs(slot, exist_ok=True)
+            self._slots.put(slot)
+        # One pool for the scheduler's lifetime: compile_fns keep per-thread state (fork servers, edge maps)
+        # that would otherwise be recreated, and leaked, for every batch
+        self._pool = ThreadPoolExecutor(max_workers=self.max_workers, thread_name_prefix="compile")
+
+    def _compile_one(self, index: int, program_path: str, compile_options: Optional[str], gcc_path: Optional[str],
+                     stage: Optional[str]):
+        slot = self._slots.get()
+        prefix = os.path.join(self.profile_dir, f"program_{index}") if self.per_program_profiles else slot
+        try:
+            env = dict(os.environ)
+            env["GCOV_PREFIX"] = prefix
+            env["GCOV_PREFIX_STRIP"] = str(self.prefix_strip)
+            start = time.time()
+            success, err = self.compile_fn(program_path, compile_options, gcc_path, self.timeout_sec, env,
+                                           stage=stage)
+            return success, err, time.time() - start, prefix
+        except Exception as e:
+            return False, f"Compilation error: {type(e).__name__}: {e}", 0.0, prefix
+        finally:
+            self._slots.put(slot)
+
+    def run(self, program_paths: List[str], compile_options: Optional[str] = None, gcc_path: Optional[str] = None,
+            before_fold: Optional[Callable[[List[Tuple[str, bool, Optional[str], str]]], None]] = None,
+            stage: Optional[str] = None) -> List[Tuple[str, bool, Optional[str]]]:
+        """
+        Compile all programs and fold their coverage into the real .gcda files.
+        :param before_fold: called with [(program_path, success, error_message, profile prefix)] after compiling
+                            and before folding, while each prefix still holds only that worker's (or, with
+                            per_program_profiles, that program's) counters
+        :param stage: last compilation stage to run (see stage_map.py), None = linked executable
+        :return: [(program_path, success, error_message)] in the order of program_paths
+        """
+        wall_start = time.time()
+        futures = [self._pool.submit(self._compile_one, i, p, compile_options, gcc_path, stage)
+                   for i, p in enumerate(program_paths)]
+        outcomes = [f.result() for f in futures]
+        compile_wall = time.time() - wall_start
+
+        if before_fold is not None:
+            before_fold([(p, o[0], o[1], o[3]) for p, o in zip(program_paths, outcomes)])
+
+        merge_start = time.time()
+        folded = self.fold_profiles()
+        merge_time = time.time() - merge_start
+
+        compile_time = sum(o[2] for o in outcomes)
+        self.last_run_stats = {
+            "programs": len(program_paths),
+            "failed": sum(1 for o in outcomes if not o[0]),
+            "workers": self.max_workers,
+            "wall_time": compile_wall,
+            "compile_time": compile_time,
+            "speedup": compile_time / compile_wall if compile_wall > 0 else 0.0,
+            "folded_gcda": folded,
+            "merge_time": merge_time,
+        }
+        print(f"[CompileScheduler] {len(program_paths)} programs on {self.max_workers} workers: "
+              f"wall {compile_wall:.2f}s, compile {compile_time:.2f}s "
+              f"(x{self.last_run_stats['speedup']:.2f}), folded {folded} .gcda in {merge_time:.2f}s")
+        return [(p, o[0], o[1]) for p, o in zip(program_paths, outcomes)]
+
+    def close(self):
+        """Stop the worker threads (the compile_fn's own resources are closed by its owner)."""
+        self._pool.shutdown(wait=True)
+
+    def fold_profiles(self) -> int:
+        """
+        Fold every .gcda written under the worker prefixes back into the profile tree, in parallel:
+        files without a real counterpart are moved, the others are merged with all worker copies at once.
+        Files that fail to merge stay in the worker prefixes and are retried on the next fold.
+        :return: number of real .gcda files updated
+        """
+        groups: Dict[str, List[str]] = {}  # {path relative to profile_root (and fold_root): worker copies}
+        for slot in sorted(os.listdir(self.profile_dir)):
+            slot_dir = os.path.join(self.profile_dir, slot)
+            for dirpath, _, files in os.walk(slot_dir):
+                for name in files:
+                    if name.endswith(".gcda"):
+                        src = os.path.join(dirpath, name)
+                        groups.setdefault(os.path.relpath(src, slot_dir), []).append(src)
+
+        folded = 0
+        to_merge: List[str] = []
+        for rel, copies in groups.items():
+            dest = os.path.join(self.fold_root, rel)
+            if len(copies) == 1 and not os.path.exists(dest):
+                os.makedirs(os.path.dirname(dest), exist_ok=True)
+                shutil.move(copies[0], dest)
+                folded += 1
+            else:
+                to_merge.append(rel)
+        if not to_merge:
+            return folded
+
+        failed = to_merge
+        if self.merge_backend == "native":
+            failed = []
+            jobs = []
+            for rel in to_merge:
+                dest = os.path.join(self.fold_root, rel)
+                os.makedirs(os.path.dirname(dest), exist_ok=True)
+                jobs.append(([dest] if os.path.exists(dest) else []) + groups[rel])
+            with ProcessPoolExecutor(max_workers=min(self.max_workers, len(jobs))) as pool:
+                outcomes = pool.map(merge_gcda_files, jobs,
+                                    [os.path.join(self.fold_root, rel) for rel in to_merge], chunksize=8)
+                for rel, (_, err) in zip(to_merge, outcomes):
+                    if err is None:
+                        self._remove(groups[rel])
+                        folded += 1
+                    else:
+                        failed.append(rel)
+            if failed:
+                print(f"[CompileScheduler] native merge failed for {len(failed)} .gcda, using gcov-tool")
+
+        if failed:
+            n_chunks = min(self.max_workers, len(failed))
+            chunks = [failed[i::n_chunks] for i in range(n_chunks)]
+            with ThreadPoolExecutor(max_workers=n_chunks) as pool:
+                for chunk, ok in zip(chunks, pool.map(lambda c: self._tool_merge(c, groups), chunks)):
+                    if ok:
+                        folded += len(chunk)
+        return folded
+
+    def _tool_merge(self, rels: List[str], groups: Dict[str, List[str]]) -> bool:
+        """
+        Merge the given files with gcov-tool, which only works on whole directory trees of two profiles:
+        stage the real files and each worker's copies as separate trees and fold them one after another.
+        """
+        stage = tempfile.mkdtemp(prefix=".merge_", dir=os.path.dirname(self.profile_dir.rstrip(os.sep)))
+        try:
+            trees: List[str] = []
+            for rel in rels:
+                sources = groups[rel]
+                dest = os.path.join(self.fold_root, rel)
+                if os.path.exists(dest):
+                    sources = [dest] + sources
+                for k, src in enumerate(sources):
+                    if k == len(trees):
+                        trees.append(os.path.join(stage, f"tree_{k}"))
+                        os.makedirs(trees[k])
+                    staged = os.path.join(trees[k], rel)
+                    os.makedirs(os.path.dirname(staged), exist_ok=True)
+                    shutil.copyfile(src, staged)
+            acc = trees[0]
+            for k, tree in enumerate(trees[1:], 1):
+                out = os.path.join(stage, f"merged_{k}")
+                subprocess.run([self.gcov_tool_path, "merge", acc, tree, "-o", out],
+                               check=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8")
+                acc = out
+            for rel in rels:
+                dest = os.path.join(self.fold_root, rel)
+                os.makedirs(os.path.dirname(dest), exist_ok=True)
+                shutil.move(os.path.join(acc, rel), dest)
+                self._remove(groups[rel])
+            return True
+        except (OSError, subprocess.CalledProcessError) as e:
+            detail = getattr(e, "stderr", None) or str(e)
+            print(f"[CompileScheduler] gcov-tool merge failed: {detail.strip()}")
+            return False
+        finally:
+            shutil.rmtree(stage, ignore_errors=True)
+
+    @staticmethod
+    def _remove(paths: List[str]):
+        for path in paths:
+            try:
+                os.remove(path)
+            except FileNotFoundError:
+                pass
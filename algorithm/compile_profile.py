@@ -0,0 +1,188 @@
+import csv
+import json
+import os
+import re
+import statistics
+import subprocess
+import threading
+import time
+from datetime import datetime
+from typing import Dict, List, Optional, Tuple
+
+# " phase parsing    :   0.00 (  0%)   0.01 (100%)   0.01 ( 50%)   612k ( 30%)" (usr, sys, wall, GGC)
+_TIME_LINE = re.compile(r"^ (\S.*?)\s*:\s*([\d.]+) \(\s*\d+%\)\s+([\d.]+) \(\s*\d+%\)\s+([\d.]+) \(\s*\d+%\)\s+"
+                        r"(\d+[kMG]?)\s*\(\s*\d+%\)\s*$")
+_MEM_TOTAL = re.compile(r"^Total\s+(\d+[kMG]?)\s+(\d+[kMG]?)\s+(\d+[kMG]?)\s*$")
+_SIZE_UNITS = {"": 1 / 1024, "k": 1, "M": 1024, "G": 1024 * 1024}
+
+
+def _kb(size: str) -> float:
+    unit = size[-1] if size[-1] in "kMG" else ""
+    return float(size[:-1] if unit else size) * _SIZE_UNITS[unit]
+
+
+class _RusagePopen(subprocess.Popen):
+    """Popen that reaps its child with wait4, keeping the resource usage of the child and its reaped children."""
+    rusage = None
+
+    def _try_wait(self, wait_flags):
+        try:
+            pid, sts, rusage = os.wait4(self.pid, wait_flags)
+        except ChildProcessError:
+            return self.pid, 0
+        if pid:
+            self.rusage = rusage
+        return pid, sts
+
+
+def run_profiled(cmd: List[str], timeout_sec: float, env: Optional[Dict[str, str]] = None
+                 ) -> Tuple[Optional[int], str, str, Dict[str, float]]:
+    """
+    Run cmd like subprocess.run(stdout/stderr captured) and measure it.
+    :return: (return code or None on timeout, stdout, stderr, {"wall", "user", "sys", "maxrss_kb"})
+    """
+    start = time.monotonic()
+    with _RusagePopen(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", errors="replace",
+                      env=env) as proc:
+        try:
+            stdout, stderr = proc.communicate(timeout=timeout_sec)
+            returncode = proc.returncode
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            stdout, stderr = proc.communicate()
+            returncode = None
+    usage = {"wall": time.monotonic() - start, "user": 0.0, "sys": 0.0, "maxrss_kb": 0.0}
+    if proc.rusage is not None:
+        # On Linux, ru_maxrss is in KiB and covers cc1 and the other tools the driver waited for
+        usage.update(user=proc.rusage.ru_utime, sys=proc.rusage.ru_stime, maxrss_kb=float(proc.rusage.ru_maxrss))
+    return returncode, stdout or "", stderr or "", usage
+
+
+def split_reports(stderr: str) -> Tuple[str, Dict[str, Tuple[float, float]], Optional[float]]:
+    """
+    Separate -ftime-report / -fmem-report output from the diagnostics.
+    :return: (remaining stderr, {pass: (wall seconds, GGC KiB)}, GGC KiB still allocated at the end or None)
+    """
+    passes: Dict[str, Tuple[float, float]] = {}
+    ggc_total = None
+    kept: List[str] = []
+    in_mem_report = False
+    for line in stderr.splitlines():
+        if line.startswith("Time variable"):
+            in_mem_report = False
+            continue
+        if in_mem_report or line.startswith("####"):
+            # -fmem-report follows the diagnostics (and precedes -ftime-report); its first total is the
+            # GGC memory still allocated
+            in_mem_report = True
+            m = _MEM_TOTAL.match(line)
+            if m and ggc_total is None:
+                ggc_total = _kb(m.group(1))
+            continue
+        m = _TIME_LINE.match(line)
+        if m:
+            passes[m.group(1)] = (float(m.group(4)), _kb(m.group(5)))
+            continue
+        if line.startswith(" TOTAL") or line.startswith("Extra diagnostic checks enabled"):
+            continue
+        kept.append(line)
+    return "\n".join(kept).strip(), passes, ggc_total
+
+
+class CompileProfiler:
+    """
+    Per-run table of compile profiles: wall/user/sys time and peak RSS of every compile, plus the
+    per-pass breakdown of -ftime-report (and GGC memory of -fmem-report) when enabled. Compiles far
+    above the run's median (whole compile, any single pass, or peak memory) are flagged as candidate
+    compile-time/memory bugs.
+    """
+    def __init__(self, output_dir: str, time_report: bool = False, mem_report: bool = False,
+                 outlier_factor: float = 100.0, rss_factor: float = 10.0, min_seconds: float = 1.0,
+                 min_samples: int = 20):
+        """
+        :param output_dir: directory of the per-run CSV table and outlier list
+        :param time_report: add -ftime-report to every compile and record the pass breakdown
+        :param mem_report: add -fmem-report and record the GGC memory still allocated at the end
+        :param outlier_factor: a compile or pass taking more than this many times its median is an outlier
+        :param rss_factor: a compile whose peak RSS is more than this many times the median is an outlier
+        :param min_seconds: times below this are never outliers (timer resolution, noise)
+        :param min_samples: compiles recorded before outliers are flagged
+        """
+        os.makedirs(output_dir, exist_ok=True)
+        stamp = datetime.now().strftime("%Y%m%d_%H%M%S")
+        self.table_path = os.path.join(output_dir, f"compile_profile_{stamp}.csv")
+        self.outlier_path = os.path.join(output_dir, f"compile_outliers_{stamp}.jsonl")
+        self.time_report = time_report
+        self.mem_report = mem_report
+        self.outlier_factor = outlier_factor
+        self.rss_factor = rss_factor
+        self.min_seconds = min_seconds
+        self.min_samples = min_samples
+        self.outliers: List[Dict] = []
+        self._walls: List[float] = []
+        self._rss: List[float] = []
+        self._pass_walls: Dict[str, List[float]] = {}
+        self._lock = threading.Lock()
+        with open(self.table_path, "w", newline="", encoding="utf-8") as f:
+            csv.writer(f).writerow(["time", "program", "options", "stage", "success", "timeout", "wall", "user",
+                                    "sys", "maxrss_kb", "ggc_kb", "passes"])
+
+    @property
+    def extra_options(self) -> List[str]:
+        """Options added to every profiled compile."""
+        return (["-ftime-report"] if self.time_report else []) + (["-fmem-report"] if self.mem_report else [])
+
+    def _check(self, value: float, samples: List[float], factor: float, floor: float) -> Optional[float]:
+        if len(samples) < self.min_samples or value < floor:
+            return None
+        median = max(statistics.median(samples), floor / factor, 1e-9)
+        return value / median if value > factor * median else None
+
+    def record(self, program_path: str, options: Optional[str], stage: Optional[str], success: bool,
+               timed_out: bool, usage: Dict[str, float], passes: Optional[Dict[str, Tuple[float, float]]] = None,
+               ggc_kb: Optional[float] = None) -> List[str]:
+        """
+        Add one compile to the table and check it against the medians of the run so far.
+        :return: reasons the compile was flagged as an outlier (empty if it was not)
+        """
+        passes = passes or {}
+        reasons = []
+        with self._lock:
+            ratio = self._check(usage["wall"], self._walls, self.outlier_factor, self.min_seconds)
+            if ratio is not None or timed_out:
+                reasons.append("timeout" if timed_out else f"compile wall {usage['wall']:.2f}s = {ratio:.0f}x median")
+            ratio = self._check(usage["maxrss_kb"], self._rss, self.rss_factor, 0.0)
+            if ratio is not None:
+                reasons.append(f"peak RSS {usage['maxrss_kb'] / 1024:.0f} MiB = {ratio:.0f}x median")
+            for name, (wall, _) in passes.items():
+                ratio = self._check(wall, self._pass_walls.get(name, []), self.outlier_factor, self.min_seconds)
+                if ratio is not None:
+                    reasons.append(f"pass '{name}' {wall:.2f}s = {ratio:.0f}x median")
+            if not timed_out:
+                self._walls.append(usage["wall"])
+            self._rss.append(usage["maxrss_kb"])
+            for name, (wall, _) in passes.items():
+                self._pass_walls.setdefault(name, []).append(wall)
+
+            now = datetime.now().isoformat(timespec="seconds")
+            with open(self.table_path, "a", newline="", encoding="utf-8") as f:
+                csv.writer(f).writerow([now, program_path, options or "", stage or "", int(success), int(timed_out),
+                                        f"{usage['wall']:.4f}", f"{usage['user']:.4f}", f"{usage['sys']:.4f}",
+                                        int(usage["maxrss_kb"]), "" if ggc_kb is None else int(ggc_kb),
+                                        json.dumps({k: v[0] for k, v in passes.items()}) if passes else ""])
+            if reasons:
+                entry = {"time": now, "program": program_path, "options": options, "stage": stage,
+                         "reasons": reasons, "usage": usage}
+                self.outliers.append(entry)
+                with open(self.outlier_path, "a", encoding="utf-8") as f:
+                    f.write(json.dumps(entry) + "\n")
+        if reasons:
+            print(f"  [Profile] Outlier {program_path} ({options}): {'; '.join(reasons)}")
+        return reasons
+
+    def summary(self) -> str:
+        with self._lock:
+            if not self._walls:
+                return "no compiles profiled"
+            return (f"{len(self._rss)} compiles, median wall {statistics.median(self._walls):.3f}s, "
+                    f"median peak RSS {statistics.median(self._rss) / 1024:.0f} MiB, {len(self.outliers)} outliers")
@@ -0,0 +1,168 @@
+import linecache
+import os
+from pathlib import Path
+from typing import Dict, Iterator, Optional
+
+
+def iter_bits(mask: int) -> Iterator[int]:
+    """Yield the set bit positions (line numbers) of mask in increasing order."""
+    while mask:
+        low = mask & -mask
+        yield low.bit_length() - 1
+        mask ^= low
+
+
+def _bitset(lines: bytearray) -> int:
+    return int.from_bytes(lines, 'little')
+
+
+class FileCoverage:
+    """
+    Coverage state of one source file as packed bitsets (bit i = line i):
+    - executable: lines with a count (covered or "#####")
+    - covered: lines with a positive count
+    uncovered = executable & ~covered, non-executable = known lines & ~executable.
+    Source text is not kept; line_text() loads it lazily for reporting.
+    """
+    __slots__ = ("name", "n_lines", "executable", "covered", "source_path", "gcov_path", "stamp", "_text")
+
+    def __init__(self, name: str, n_lines: int, executable: int, covered: int,
+                 source_path: Optional[str] = None, gcov_path: Optional[str] = None, stamp=None):
+        self.name = name
+        self.n_lines = n_lines
+        self.executable = executable
+        self.covered = covered
+        self.source_path = source_path
+        self.gcov_path = gcov_path
+        self.stamp = stamp
+        self._text: Optional[Dict[int, str]] = None
+
+    @property
+    def known(self) -> int:
+        """Bitset of all lines 1..n_lines."""
+        return (1 << (self.n_lines + 1)) - 2
+
+    @property
+    def uncovered(self) -> int:
+        return self.executable & ~self.covered
+
+    @classmethod
+    def from_gcov(cls, name: str, gcov_path: str, stamp=None) -> "FileCoverage":
+        """
+        Parse a .gcov file into bitsets, without keeping the code text.
+        """
+        executable = bytearray()
+        covered = bytearray()
+        n_lines = 0
+        with open(gcov_path, 'r', encoding='utf-8', errors='replace') as f:
+            for raw in f:
+                parts = raw.split(':', 2)
+                if len(parts) < 3:
+                    continue
+                count = parts[0].strip().rstrip('*')
+                try:
+                    ln = int(parts[1])
+                except ValueError:
+                    continue
+                if ln <= 0 or count == '-':
+                    n_lines = max(n_lines, ln)
+                    continue
+                n_lines = max(n_lines, ln)
+                byte, bit = divmod(ln, 8)
+                if byte >= len(executable):
+                    grow = byte + 1 - len(executable)
+                    executable.extend(bytes(grow))
+                    covered.extend(bytes(grow))
+                executable[byte] |= 1 << bit
+                if count.isdigit():
+                    covered[byte] |= 1 << bit
+        return cls(name, n_lines, _bitset(executable), _bitset(covered), gcov_path=gcov_path, stamp=stamp)
+
+    @classmethod
+    def from_counts(cls, name: str, counts, source_path: Optional[str] = None) -> "FileCoverage":
+        """
+        Build bitsets from per-line counts (-1 = not executable, 0 = uncovered).
+        """
+        n = len(counts)
+        executable = bytearray((n + 7) // 8)
+        covered = bytearray((n + 7) // 8)
+        for ln, c in enumerate(counts):
+            if c >= 0:
+                byte, bit = divmod(ln, 8)
+                executable[byte] |= 1 << bit
+                if c > 0:
+                    covered[byte] |= 1 << bit
+        return cls(name, max(n - 1, 0), _bitset(executable), _bitset(covered),
+                   source_path=source_path, stamp=counts)
+
+    def line_text(self, ln: int) -> str:
+        """Return the code of line ln, read lazily from the source or .gcov file."""
+        if self.source_path:
+            return linecache.getline(self.source_path, ln).rstrip('\n')
+        if self._text is None:
+            self._text = {}
+            if self.gcov_path and os.path.isfile(self.gcov_path):
+                with open(self.gcov_path, 'r', encoding='utf-8', errors='replace') as f:
+                    for raw in f:
+                        parts = raw.rstrip('\n').split(':', 2)
+                        if len(parts) == 3 and parts[1].strip().isdigit():
+                            self._text[int(parts[1])] = parts[2]
+        return self._text.get(ln, "")
+
+
+class CoverageSnapshot:
+    """
+    Coverage state of all files, keyed by source basename.
+    Snapshots are built incrementally: files whose .gcov (mtime, size) or in-memory counts object
+    did not change reuse the previous snapshot's FileCoverage, so both building and diffing are
+    proportional to the number of changed files.
+    """
+    def __init__(self, files: Optional[Dict[str, FileCoverage]] = None):
+        self.files: Dict[str, FileCoverage] = files or {}
+
+    @classmethod
+    def from_gcov_dir(cls, coverage_dir: str, previous: Optional["CoverageSnapshot"] = None) -> "CoverageSnapshot":
+        files: Dict[str, FileCoverage] = {}
+        for f in Path(coverage_dir).glob("*.gcov"):
+            st = f.stat()
+            stamp = (st.st_mtime_ns, st.st_size)
+            name = f.name[:-len(".gcov")]
+            old = previous.files.get(name) if previous else None
+            if old is not None and old.stamp == stamp:
+                files[name] = old
+            else:
+                files[name] = FileCoverage.from_gcov(name, str(f), stamp=stamp)
+        return cls(files)
+
+    @classmethod
+    def from_line_counts(cls, line_counts: Dict, source_paths: Dict[str, str],
+                         previous: Optional["CoverageSnapshot"] = None) -> "CoverageSnapshot":
+        files: Dict[str, FileCoverage] = {}
+        for name, counts in line_counts.items():
+            old = previous.files.get(name) if previous else None
+            if old is not None and old.stamp is counts:
+                files[name] = old
+            else:
+                files[name] = FileCoverage.from_counts(name, counts, source_paths.get(name))
+        return cls(files)
+
+    def newly_covered(self, before: "CoverageSnapshot") -> Dict[str, int]:
+        """
+        Lines that were uncovered ("#####" or unknown) in before and are covered now.
+        :return: {name: bitset of newly covered lines}, only for files with at least one such line
+        """
+        result: Dict[str, int] = {}
+        for name, after in self.files.items():
+            old = before.files.get(name)
+            if old is after:
+                continue
+            if old is None:
+                mask = after.covered
+            else:
+                if old.covered == after.covered:
+                    continue
+                not_executable_before = old.known & ~old.executable
+                mask = after.covered & ~old.covered & ~not_executable_before
+            if mask:
+                result[name] = mask
+        return result
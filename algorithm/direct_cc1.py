@@ -0,0 +1,165 @@
+import os
+import shlex
+import subprocess
+import threading
+from pathlib import Path
+from typing import Callable, Dict, List, Optional, Tuple
+
+from algorithm.compile_profile import CompileProfiler, run_profiled, split_reports
+from algorithm.scratch import output_path
+
+ICE_EXIT_CODE = 4  # exit code of cc1 on an internal compiler error
+
+# Placeholders of the cached `gcc -###` expansion, replaced per program
+_TEMPLATE_DIR = "/gapsmith-forkserver"
+_TEMPLATE_STEM = "GAPSMITH_PROGRAM"
+
+# Stages whose output only the compiler proper produces: no assembler or linker is needed
+CC1_ONLY_STAGES = ("parse", "gimple", "rtl")
+
+
+class DirectCC1Compiler:
+    """
+    compile_fn for CompileScheduler that runs the compiler proper without the driver.
+    The driver is asked once per (compiler, options, source suffix) for its cc1 command (`gcc -### -S`);
+    each program then costs one cc1 process instead of gcc + cc1 (+ as + collect2), writing to /dev/null.
+    Only stages that need nothing after cc1 (parse/gimple/rtl, see stage_map.py) run directly; other
+    stages and options the driver cannot expand fall back to fallback_fn (normal compilation).
+    """
+    def __init__(self, fallback_fn: Callable[..., Tuple[bool, Optional[str]]],
+                 profiler: Optional[CompileProfiler] = None, output_dir: Optional[str] = None):
+        """
+        :param fallback_fn: compile_program-compatible function used when cc1 alone cannot do the compile
+        :param profiler: records time, peak memory and pass breakdown of every cc1 run
+        :param output_dir: directory of the per-program auxiliary files (default: next to the source)
+        """
+        self.fallback_fn = fallback_fn
+        self.profiler = profiler
+        self.output_dir = output_dir
+        self._templates: Dict[Tuple[str, str, str], Optional[List[str]]] = {}
+        self._lock = threading.Lock()
+        self.stats = {"jobs": 0, "fallbacks": 0, "ices": 0, "timeouts": 0, "time": 0.0}
+
+    def handles(self, stage: Optional[str]) -> bool:
+        """Whether a compile up to stage can run on cc1 alone."""
+        return stage in CC1_ONLY_STAGES
+
+    def cc1_template(self, gcc_path: str, options: str, suffix: str = ".c") -> Optional[List[str]]:
+        """
+        cc1 command line for the options, with placeholder input/output paths (cached).
+        :param suffix: suffix of the source files (".i" makes the driver pass -fpreprocessed)
+        :return: argv, or None if the driver rejects the options or does not run cc1
+        """
+        key = (gcc_path, options, suffix)
+        with self._lock:
+            if key in self._templates:
+                return self._templates[key]
+        src = f"{_TEMPLATE_DIR}/{_TEMPLATE_STEM}{suffix}"
+        out = f"{_TEMPLATE_DIR}/{_TEMPLATE_STEM}.s"
+        argv = None
+        try:
+            res = subprocess.run([gcc_path, "-###"] + shlex.split(options) + ["-S", src, "-o", out],
+                                 stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8", timeout=30)
+            if res.returncode == 0:
+                for line in res.stderr.splitlines():
+                    if line.startswith(" "):
+                        cmd = shlex.split(line)
+                        if cmd and os.path.basename(cmd[0]).startswith("cc1"):
+                            argv = cmd
+                            break
+        except (OSError, ValueError, subprocess.TimeoutExpired):
+            argv = None
+        with self._lock:
+            self._templates[key] = argv
+        return argv
+
+    @staticmethod
+    def instantiate(template: List[str], program_path: str, output_path: str) -> List[str]:
+        suffix = Path(program_path).suffix
+        out_dir = os.path.dirname(os.path.abspath(output_path))
+        out_stem = Path(output_path).stem
+        result = []
+        for arg in template:
+            arg = arg.replace(f"{_TEMPLATE_DIR}/{_TEMPLATE_STEM}{suffix}", program_path)
+            arg = arg.replace(f"{_TEMPLATE_DIR}/{_TEMPLATE_STEM}.s", output_path)
+            arg = arg.replace(f"{_TEMPLATE_DIR}/", out_dir + "/").replace(_TEMPLATE_STEM, out_stem)
+            result.append(arg)
+        return result
+
+    def cc1_command(self, program_path: str, options: str, gcc_path: str,
+                    stage: Optional[str]) -> Optional[List[str]]:
+        """
+        cc1 argv for one program (profiler options included), or None if it must go through the driver.
+        """
+        if not self.handles(stage):
+            return None
+        src = Path(program_path)
+        cc1_options = options + " -fsyntax-only" if stage == "parse" else options
+        if self.profiler is not None and self.profiler.extra_options:
+            cc1_options += " " + " ".join(self.profiler.extra_options)
+        template = self.cc1_template(gcc_path, cc1_options, src.suffix or ".c")
+        if template is None:
+            return None
+        asm = str(output_path(self.output_dir, str(src), ".s") if self.output_dir else src.with_suffix(".s"))
+        argv = self.instantiate(template, str(src), asm)
+        if stage in CC1_ONLY_STAGES:
+            # Assembly is only kept when a later stage would consume it
+            argv = [os.devnull if arg == asm else arg for arg in argv]
+        return argv
+
+    def _fallback(self, program_path: str, compile_options: Optional[str], gcc_path: str, timeout_sec: int,
+                  env: Optional[Dict[str, str]], stage: Optional[str]) -> Tuple[bool, Optional[str]]:
+        with self._lock:
+            self.stats["fallbacks"] += 1
+        return self.fallback_fn(program_path, compile_options, gcc_path, timeout_sec, env, stage=stage)
+
+    def _result(self, program_path: str, options: str, stage: Optional[str], status: Optional[int], message: str,
+                usage: Dict[str, float], timeout_sec: int) -> Tuple[bool, Optional[str]]:
+        """
+        Record and interpret one cc1 run.
+        :param status: wait status of cc1, or None on timeout
+        :param message: stdout and stderr of cc1
+        """
+        if self.profiler is not None:
+            passes, ggc_kb = {}, None
+            if self.profiler.extra_options:
+                message, passes, ggc_kb = split_reports(message)
+            success = status is not None and os.WIFEXITED(status) and os.WEXITSTATUS(status) == 0
+            self.profiler.record(program_path, options, stage, success, status is None, usage, passes, ggc_kb)
+        message = message.strip()
+        with self._lock:
+            self.stats["jobs"] += 1
+            self.stats["time"] += usage.get("wall", 0.0)
+            if status is None:
+                self.stats["timeouts"] += 1
+        if status is None:
+            return False, f"Compilation error: Timeout (> {timeout_sec}s)"
+        if os.WIFSIGNALED(status):
+            return False, f"Compilation error: cc1 killed by signal {os.WTERMSIG(status)}\n{message}".strip()
+        code = os.WEXITSTATUS(status)
+        if code == 0:
+            return True, None
+        if code == ICE_EXIT_CODE:
+            with self._lock:
+                self.stats["ices"] += 1
+        return False, f"Compilation error: {message or f'cc1 exited with status {code}'}"
+
+    def __call__(self, program_path: str, compile_options: Optional[str] = None, gcc_path: Optional[str] = None,
+                 timeout_sec: int = 60, env: Optional[Dict[str, str]] = None,
+                 stage: Optional[str] = None) -> Tuple[bool, Optional[str]]:
+        if not Path(program_path).is_file():
+            return False, f"Compilation error: Source file does not exist: {program_path}"
+        gcc_path = gcc_path or "gcc-build/bin/gcc"
+        options = compile_options.strip() if compile_options else "-O3"
+        argv = self.cc1_command(program_path, options, gcc_path, stage)
+        if argv is None:
+            return self._fallback(program_path, compile_options, gcc_path, timeout_sec, env, stage)
+
+        returncode, stdout, stderr, usage = run_profiled(argv, timeout_sec, env)
+        if returncode is None:
+            status = None
+        elif returncode < 0:
+            status = -returncode  # killed by a signal: same encoding as a wait status
+        else:
+            status = returncode << 8
+        return self._result(program_path, options, stage, status, (stdout + stderr), usage, timeout_sec)
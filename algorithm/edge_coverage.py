@@ -0,0 +1,152 @@
+import mmap
+import os
+import subprocess
+import tempfile
+import threading
+from typing import Callable, Dict, List, Optional, Set, Tuple
+
+
+class EdgeCoverage:
+    """
+    Fast coverage feedback from a compiler built with -fsanitize-coverage=trace-pc and edge_runtime.c.
+    Every compile gets a cleared shared-memory hit map (one per worker thread); after the compile the
+    map is compared with the global virgin map, and new block ids are mapped back to file:line through
+    the binary's debug info (addr2line, cached). This replaces gcov for per-iteration feedback; the gcov
+    path is still used for the selector's reports and final, precise coverage.
+    """
+    def __init__(self, binary_path: str, map_dir: str = "/dev/shm", addr2line_path: str = "addr2line"):
+        """
+        :param binary_path: instrumented compiler proper with debug info (e.g. .../cc1); only it records hits
+        :param map_dir: directory of the per-thread map files (a tmpfs keeps them in memory)
+        :param addr2line_path: path to addr2line, used to map block ids to source lines
+        """
+        self.binary_path = binary_path
+        self.map_dir = map_dir
+        self.addr2line_path = addr2line_path
+        self.exe_name = os.path.basename(binary_path)
+        self.image_base, image_end = self._image_span(binary_path)
+        self.map_size = max(1, ((image_end - self.image_base) >> 2) // 8 + 1)
+
+        self.virgin = 0  # bitset of all blocks ever hit
+        self._new_slots: List[int] = []  # blocks first hit since the last take_new_lines()
+        self._lines: Dict[int, Optional[Tuple[str, int]]] = {}  # {slot: (file, line)}
+        self._lock = threading.Lock()
+        self._local = threading.local()
+        self._maps: List[list] = []  # [path, map, owning thread]
+
+    @staticmethod
+    def _image_span(binary_path: str) -> Tuple[int, int]:
+        """Link-time address range of the loaded image (__executable_start is the first LOAD segment)."""
+        out = subprocess.run(["readelf", "-lW", binary_path], stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                             encoding="utf-8", check=True).stdout
+        start, end = None, 0
+        for line in out.splitlines():
+            parts = line.split()
+            if parts and parts[0] == "LOAD":
+                vaddr, memsz = int(parts[2], 16), int(parts[5], 16)
+                start = vaddr if start is None else min(start, vaddr)
+                end = max(end, vaddr + memsz)
+        if start is None:
+            raise ValueError(f"no LOAD segments in {binary_path}")
+        return start, end
+
+    def _thread_map(self) -> Tuple[str, mmap.mmap]:
+        entry = getattr(self._local, "map", None)
+        if entry is None:
+            current = threading.current_thread()
+            with self._lock:
+                # Take over the map of a thread that has exited (e.g. a finished pool) before creating one
+                for candidate in self._maps:
+                    if not candidate[2].is_alive():
+                        candidate[2] = current
+                        entry = candidate
+                        break
+            if entry is None:
+                fd, path = tempfile.mkstemp(prefix="gapsmith_edge_", dir=self.map_dir)
+                os.ftruncate(fd, self.map_size)
+                entry = [path, mmap.mmap(fd, self.map_size), current]
+                os.close(fd)
+                with self._lock:
+                    self._maps.append(entry)
+            self._local.map = entry
+        return entry[0], entry[1]
+
+    def wrap(self, compile_fn: Callable[..., Tuple[bool, Optional[str]]]) -> Callable[..., Tuple[bool, Optional[str]]]:
+        """
+        Wrap a compile_program-compatible function so every compile records its hit map.
+        """
+        def compile_with_edges(program_path, compile_options=None, gcc_path=None, timeout_sec=60, env=None, stage=None):
+            path, hits = self._thread_map()
+            hits[:] = bytes(self.map_size)
+            env = dict(env if env is not None else os.environ)
+            env["GAPSMITH_EDGE_MAP"] = f"{path}:{self.map_size}:{self.exe_name}"
+            result = compile_fn(program_path, compile_options, gcc_path, timeout_sec, env, stage=stage)
+            self.record(hits[:])
+            return result
+        return compile_with_edges
+
+    def record(self, hit_map: bytes) -> int:
+        """
+        Fold one compile's hit map into the virgin map.
+        :return: number of blocks hit for the first time
+        """
+        bits = int.from_bytes(hit_map, 'little')
+        with self._lock:
+            new = bits & ~self.virgin
+            if not new:
+                return 0
+            self.virgin |= new
+            count = 0
+            while new:
+                low = new & -new
+                self._new_slots.append(low.bit_length() - 1)
+                new ^= low
+                count += 1
+            return count
+
+    def _symbolize(self, slots: List[int]):
+        unknown = [s for s in slots if s not in self._lines]
+        if not unknown:
+            return
+        # A slot is (return address >> 2); for any return address in [4s, 4s+3], 4s-2 lies inside the
+        # 5-byte call instruction, i.e. on the line of the instrumented block
+        addrs = "\n".join(f"{self.image_base + (s << 2) - 2:#x}" for s in unknown)
+        try:
+            out = subprocess.run([self.addr2line_path, "-e", self.binary_path], input=addrs,
+                                 stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8").stdout
+        except OSError:
+            out = ""
+        results = out.splitlines()
+        for i, slot in enumerate(unknown):
+            loc = None
+            if i < len(results):
+                file, _, line = results[i].rpartition(":")
+                line = line.split(" ")[0]
+                if file and file != "??" and line.isdigit() and int(line) > 0:
+                    loc = (file, int(line))
+            self._lines[slot] = loc
+
+    def take_new_lines(self) -> Dict[str, Set[int]]:
+        """
+        Source lines of the blocks first hit since the previous call.
+        :return: {source file path: set of line numbers}
+        """
+        with self._lock:
+            slots, self._new_slots = self._new_slots, []
+        self._symbolize(slots)
+        result: Dict[str, Set[int]] = {}
+        for slot in slots:
+            loc = self._lines.get(slot)
+            if loc is not None:
+                result.setdefault(loc[0], set()).add(loc[1])
+        return result
+
+    def close(self):
+        with self._lock:
+            maps, self._maps = self._maps, []
+        for path, hits, _ in maps:
+            hits.close()
+            try:
+                os.remove(path)
+            except FileNotFoundError:
+                pass
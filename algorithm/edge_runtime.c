@@ -0,0 +1,80 @@
+/*
+ * Edge-coverage runtime for a GCC built with -fsanitize-coverage=trace-pc (see edge_coverage.py).
+ *
+ * Every instrumented basic block calls __sanitizer_cov_trace_pc(); the return address, relative to
+ * __executable_start, identifies the block. Because each call instruction is at least 5 bytes long,
+ * (offset >> 2) is unique per call site and indexes one bit of a shared-memory map.
+ *
+ * The map is enabled by GAPSMITH_EDGE_MAP="<file>:<size in bytes>:<program name>", normally a file in
+ * /dev/shm created and cleared by GapSmith. Only the named program (e.g. cc1) records hits, so the
+ * driver and other tools of the same build leave the map alone. Without the variable the call is a no-op.
+ *
+ * This file must not be instrumented itself. Build and link it into the compiler, e.g.:
+ *   cc -O2 -fPIC -c edge_runtime.c -o edge_runtime.o
+ *   .../configure CFLAGS="-g -fsanitize-coverage=trace-pc" CXXFLAGS="-g -fsanitize-coverage=trace-pc" \
+ *                 LDFLAGS="$PWD/edge_runtime.o"
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+extern char __executable_start;
+
+static volatile uint8_t *edge_map;
+static uintptr_t edge_map_bits;
+static int edge_state; /* 0 = not initialized, 1 = recording, -1 = disabled */
+
+static void edge_init(void)
+{
+    edge_state = -1;
+    const char *spec = getenv("GAPSMITH_EDGE_MAP");
+    if (!spec)
+        return;
+    const char *sep = strrchr(spec, ':');
+    if (!sep || strcmp(sep + 1, program_invocation_short_name) != 0)
+        return;
+    char path[4096];
+    const char *size_sep = NULL;
+    for (const char *p = spec; p < sep; p++)
+        if (*p == ':')
+            size_sep = p;
+    if (!size_sep || (size_t)(size_sep - spec) >= sizeof(path))
+        return;
+    memcpy(path, spec, (size_t)(size_sep - spec));
+    path[size_sep - spec] = '\0';
+    size_t size = strtoull(size_sep + 1, NULL, 10);
+    if (!size)
+        return;
+
+    int saved_errno = errno;
+    int fd = open(path, O_RDWR);
+    if (fd >= 0) {
+        void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map != MAP_FAILED) {
+            edge_map = map;
+            edge_map_bits = (uintptr_t)size * 8;
+            edge_state = 1;
+        }
+    }
+    errno = saved_errno;
+}
+
+void __sanitizer_cov_trace_pc(void)
+{
+    if (__builtin_expect(edge_state <= 0, 0)) {
+        if (edge_state < 0)
+            return;
+        edge_init();
+        if (edge_state < 0)
+            return;
+    }
+    uintptr_t slot = ((uintptr_t)__builtin_return_address(0) - (uintptr_t)&__executable_start) >> 2;
+    if (slot < edge_map_bits)
+        edge_map[slot >> 3] |= (uint8_t)(1u << (slot & 7));
+}
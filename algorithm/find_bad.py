@@ -14,8 +14,13 @@ class BadCaseFinder:
                 case2.json
                 ...
     """
-    def __init__(self, bad_cases_dir: str = "bad_cases", seed: int | None = None):
+    def __init__(self, bad_cases_dir: str = "bad_cases", seed: int | None = None, attribution=None):
+        """
+        :param attribution: optional CoverageAttributionDB; bad cases that list their programs
+                            ("programs": [[program_hash, compile_options], ...]) then cite them individually
+        """
         self.bad_cases_dir = Path(bad_cases_dir)
+        self.attribution = attribution
 
         if seed is not None:
             random.seed(seed)
@@ -75,6 +80,42 @@ class BadCaseFinder:
         )
 
 
+    def format_programs(self, data: dict, max_programs: int = 5, max_source_chars: int = 1500) -> str:
+        """
+        Cite the programs of a bad case from the attribution database: whether each one compiled,
+        and which files it covered instead of the target. The source of the first compiled program is included.
+        """
+        if self.attribution is None or not data.get("programs"):
+            return ""
+        lines = []
+        example = None
+        for program_hash, options in data["programs"][:max_programs]:
+            record = self.attribution.program_record(program_hash, options)
+            if record is None:
+                continue
+            name = Path(record["path"]).name
+            if not record["compiled"]:
+                error = (record["error"] or "").replace("Compilation error: ", "").strip().splitlines()
+                lines.append(f"- {name} [{options}]: compilation failed: {error[0] if error else 'unknown error'}")
+                continue
+            if example is None:
+                example = record["path"]
+            if record["files"]:
+                covered = ", ".join(f"{f} ({len(ls)})" for f, ls in sorted(record["files"].items()))
+                lines.append(f"- {name} [{options}]: covered new lines only in: {covered}")
+            else:
+                lines.append(f"- {name} [{options}]: no new coverage")
+        if not lines:
+            return ""
+        out = "Programs generated from that prompt:\n" + "\n".join(lines) + "\n"
+        if example:
+            try:
+                code = Path(example).read_text(encoding="utf-8", errors="replace")[:max_source_chars]
+                out += f"One of these programs ({Path(example).name}):\n{code}\n"
+            except OSError:
+                pass
+        return out
+
     def run(self, target_file: str) -> str:
         """
         Main execution:
@@ -87,7 +128,7 @@ class BadCaseFinder:
         json_path = self.pick_random_json(folder)
 
         data = json.loads(json_path.read_text(encoding="utf-8"))
-        formatted = self.format_output(data)
+        formatted = self.format_output(data) + self.format_programs(data)
 
         print(f"[find_bad] target_file   : {target_file}")
         print(f"[find_bad] matched_folder: {folder}")
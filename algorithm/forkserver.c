@@ -0,0 +1,141 @@
+/*
+ * Fork server for an instrumented cc1 (loaded with LD_PRELOAD, see forkserver.py).
+ *
+ * __libc_start_main is interposed so that the server loop runs in place of main(), after the
+ * dynamic loader, libc and all static constructors of cc1 have run. For every job the server
+ * forks; the child takes a fresh argv, GCOV_PREFIX and stdout/stderr file and calls the real main.
+ * Its counters are written by libgcov at exit into the job's prefix, while the server itself
+ * never executes main and stays clean.
+ *
+ * Enabled only when GAPSMITH_FORKSRV="<request fd>,<reply fd>" is set; otherwise cc1 runs normally.
+ *
+ * Request: u32 length, then length bytes of NUL-terminated strings:
+ *          gcov prefix, output file (stdout+stderr), argv[0], ..., argv[n-1]
+ * Reply:   i32 child pid, then once the child has exited: i32 wait status and i64 user time (us),
+ *          i64 system time (us), i64 peak RSS (KiB) of the child
+ *
+ * Build: cc -shared -fPIC -O2 -o libgapsmith_forkserver.so forkserver.c -ldl
+ */
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+typedef int (*main_fn)(int, char **, char **);
+typedef int (*start_main_fn)(main_fn, int, char **, void (*)(void), void (*)(void), void (*)(void), void *);
+
+static main_fn real_main;
+static int request_fd = -1;
+static int reply_fd = -1;
+
+static int read_full(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+    while (len) {
+        ssize_t n = read(fd, p, len);
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static void run_child(char *payload, uint32_t len, char **envp)
+{
+    char *fields[4096];
+    int n = 0;
+    char *p = payload;
+    char *end = payload + len;
+    while (p < end && n < 4095) {
+        fields[n++] = p;
+        p += strlen(p) + 1;
+    }
+    fields[n] = NULL;
+    if (n < 3)
+        _exit(127);
+
+    close(request_fd);
+    close(reply_fd);
+    setenv("GCOV_PREFIX", fields[0], 1);
+    int out = open(fields[1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out >= 0) {
+        dup2(out, STDOUT_FILENO);
+        dup2(out, STDERR_FILENO);
+        close(out);
+    }
+    /* exit() runs the libgcov destructor, which dumps the counters under GCOV_PREFIX */
+    exit(real_main(n - 2, fields + 2, environ ? environ : envp));
+}
+
+static int serve(int argc, char **argv, char **envp)
+{
+    (void)argc;
+    (void)argv;
+    /* The server leaves with _exit(): its counters only hold start-up code and must not be dumped */
+    for (;;) {
+        uint32_t len;
+        if (read_full(request_fd, &len, sizeof(len)) < 0)
+            _exit(0);
+        char *payload = malloc((size_t)len + 1);
+        if (!payload || read_full(request_fd, payload, len) < 0)
+            _exit(1);
+        payload[len] = '\0';
+
+        pid_t pid = fork();
+        if (pid < 0)
+            _exit(1);
+        if (pid == 0)
+            run_child(payload, len, envp);
+        free(payload);
+
+        int32_t reply = (int32_t)pid;
+        if (write_full(reply_fd, &reply, sizeof(reply)) < 0)
+            _exit(1);
+        int status = 0;
+        struct rusage usage;
+        if (wait4(pid, &status, 0, &usage) < 0)
+            _exit(1);
+        reply = (int32_t)status;
+        int64_t stats[3] = {
+            (int64_t)usage.ru_utime.tv_sec * 1000000 + usage.ru_utime.tv_usec,
+            (int64_t)usage.ru_stime.tv_sec * 1000000 + usage.ru_stime.tv_usec,
+            (int64_t)usage.ru_maxrss,
+        };
+        if (write_full(reply_fd, &reply, sizeof(reply)) < 0 || write_full(reply_fd, stats, sizeof(stats)) < 0)
+            _exit(1);
+    }
+}
+
+int __libc_start_main(main_fn main, int argc, char **argv, void (*init)(void), void (*fini)(void),
+                      void (*rtld_fini)(void), void *stack_end)
+{
+    start_main_fn next = (start_main_fn)dlsym(RTLD_NEXT, "__libc_start_main");
+    const char *fds = getenv("GAPSMITH_FORKSRV");
+    if (fds && sscanf(fds, "%d,%d", &request_fd, &reply_fd) == 2) {
+        real_main = main;
+        unsetenv("GAPSMITH_FORKSRV");
+        unsetenv("LD_PRELOAD");
+        return next(serve, argc, argv, init, fini, rtld_fini, stack_end);
+    }
+    return next(main, argc, argv, init, fini, rtld_fini, stack_end);
+}
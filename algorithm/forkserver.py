@@ -0,0 +1,197 @@
+import os
+import select
+import signal
+import struct
+import subprocess
+import tempfile
+import threading
+import time
+from pathlib import Path
+from typing import Callable, Dict, List, Optional, Tuple
+
+from algorithm.compile_profile import CompileProfiler
+from algorithm.direct_cc1 import DirectCC1Compiler
+
+SHIM_SOURCE = Path(__file__).with_name("forkserver.c")
+
+
+def build_shim(output_dir: Optional[str] = None, host_cc: str = "cc") -> str:
+    """
+    Compile forkserver.c into a preloadable shared library (rebuilt only when the source is newer).
+    :return: path of the shared library
+    """
+    output_dir = output_dir or os.path.join(tempfile.gettempdir(), "gapsmith_forkserver")
+    os.makedirs(output_dir, exist_ok=True)
+    lib = os.path.join(output_dir, "libgapsmith_forkserver.so")
+    if not os.path.exists(lib) or os.path.getmtime(lib) < SHIM_SOURCE.stat().st_mtime:
+        tmp = f"{lib}.{os.getpid()}"
+        subprocess.run([host_cc, "-shared", "-fPIC", "-O2", "-o", tmp, str(SHIM_SOURCE), "-ldl"],
+                       check=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        os.replace(tmp, lib)
+    return lib
+
+
+class ForkServer:
+    """
+    One pre-initialized cc1 process (forkserver.c preloaded) that forks a child per job.
+    Jobs are served one at a time; run several servers for parallelism.
+    """
+    def __init__(self, cc1_path: str, shim_path: str, env: Optional[Dict[str, str]] = None):
+        """
+        :param cc1_path: compiler proper to pre-initialize (e.g. .../libexec/gcc/<target>/<ver>/cc1)
+        :param shim_path: library built by build_shim()
+        :param env: environment of the server (and thus of every job), e.g. GCOV_PREFIX_STRIP
+        """
+        self.cc1_path = cc1_path
+        self.shim_path = shim_path
+        self.env = dict(env if env is not None else os.environ)
+        self.proc: Optional[subprocess.Popen] = None
+        self.restarts = 0
+        self.last_usage: Dict[str, float] = {}  # user, sys (seconds) and maxrss_kb of the last job
+
+    def start(self):
+        req_r, req_w = os.pipe()
+        rep_r, rep_w = os.pipe()
+        env = dict(self.env)
+        env["LD_PRELOAD"] = self.shim_path
+        env["GAPSMITH_FORKSRV"] = f"{req_r},{rep_w}"
+        try:
+            self.proc = subprocess.Popen([self.cc1_path], env=env, pass_fds=(req_r, rep_w),
+                                         stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL,
+                                         stderr=subprocess.DEVNULL)
+        finally:
+            os.close(req_r)
+            os.close(rep_w)
+        self._request = req_w
+        self._reply = rep_r
+
+    def close(self):
+        if self.proc is None:
+            return
+        os.close(self._request)  # EOF makes the server exit
+        os.close(self._reply)
+        try:
+            self.proc.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            self.proc.kill()
+            self.proc.wait()
+        self.proc = None
+
+    def _read(self, size: int) -> bytes:
+        data = b""
+        while len(data) < size:
+            chunk = os.read(self._reply, size - len(data))
+            if not chunk:
+                raise EOFError("fork server exited")
+            data += chunk
+        return data
+
+    def _read_int(self, timeout: Optional[float]) -> Optional[int]:
+        if timeout is not None and not select.select([self._reply], [], [], max(timeout, 0))[0]:
+            return None
+        return struct.unpack("<i", self._read(4))[0]
+
+    def _read_usage(self):
+        user_us, sys_us, maxrss = struct.unpack("<qqq", self._read(24))
+        self.last_usage = {"user": user_us / 1e6, "sys": sys_us / 1e6, "maxrss_kb": float(maxrss)}
+
+    def run(self, argv: List[str], gcov_prefix: str, output_path: str, timeout_sec: float) -> Optional[int]:
+        """
+        Run cc1 with argv (argv[0] included) in a forked child.
+        :param gcov_prefix: GCOV_PREFIX of the child, where its counters are dumped at exit
+        :param output_path: file receiving the child's stdout and stderr
+        :return: wait status of the child, or None on timeout (the child is killed); its resource usage is
+                 left in last_usage
+        """
+        if self.proc is None or self.proc.poll() is not None:
+            if self.proc is not None:
+                self.restarts += 1
+            self.start()
+        payload = b"".join(os.fsencode(s) + b"\0" for s in [gcov_prefix, output_path] + argv)
+        try:
+            os.write(self._request, struct.pack("<I", len(payload)) + payload)
+            pid = self._read_int(None)
+            status = self._read_int(timeout_sec)
+            if status is None:
+                try:
+                    os.kill(pid, signal.SIGKILL)
+                except ProcessLookupError:
+                    pass
+                self._read_int(None)
+            self._read_usage()
+            return status
+        except (OSError, EOFError):
+            self.close()
+            raise
+
+
+class ForkServerCompiler(DirectCC1Compiler):
+    """
+    compile_fn for CompileScheduler that runs the compiler proper through per-thread fork servers.
+    The cc1 command comes from the cached driver expansion of DirectCC1Compiler, so each program costs a
+    fork instead of starting gcc, cc1, as and collect2. Programs are compiled to assembly at most (no
+    assembler/linker), which is where the compiler coverage is.
+    Options the driver cannot expand, the "lto" stage (which needs lto1 at link time) and the "preprocess"
+    stage fall back to fallback_fn (normal compilation).
+    """
+    def __init__(self, fallback_fn: Callable[..., Tuple[bool, Optional[str]]], shim_path: Optional[str] = None,
+                 host_cc: str = "cc", profiler: Optional[CompileProfiler] = None, output_dir: Optional[str] = None):
+        """
+        :param fallback_fn: compile_program-compatible function used when no cc1 command can be derived
+        :param shim_path: prebuilt forkserver library (default: build forkserver.c with host_cc)
+        :param host_cc: host C compiler used to build the library
+        :param profiler: records time, peak memory and pass breakdown of every forked cc1
+        :param output_dir: directory of the per-program auxiliary files and logs (default: next to the source)
+        """
+        super().__init__(fallback_fn, profiler, output_dir)
+        self.shim_path = shim_path or build_shim(host_cc=host_cc)
+        self._local = threading.local()
+        self._servers: List[ForkServer] = []
+
+    def handles(self, stage: Optional[str]) -> bool:
+        return stage not in ("lto", "preprocess")
+
+    def _server(self, cc1_path: str, env: Dict[str, str]) -> ForkServer:
+        servers = getattr(self._local, "servers", None)
+        if servers is None:
+            servers = self._local.servers = {}
+        server = servers.get(cc1_path)
+        if server is None:
+            server = servers[cc1_path] = ForkServer(cc1_path, self.shim_path, env)
+            with self._lock:
+                self._servers.append(server)
+        return server
+
+    def __call__(self, program_path: str, compile_options: Optional[str] = None, gcc_path: Optional[str] = None,
+                 timeout_sec: int = 60, env: Optional[Dict[str, str]] = None,
+                 stage: Optional[str] = None) -> Tuple[bool, Optional[str]]:
+        src = Path(program_path)
+        if not src.is_file():
+            return False, f"Compilation error: Source file does not exist: {program_path}"
+        gcc_path = gcc_path or "gcc-build/bin/gcc"
+        options = compile_options.strip() if compile_options else "-O3"
+        argv = self.cc1_command(program_path, options, gcc_path, stage)
+        if argv is None:
+            return self._fallback(program_path, compile_options, gcc_path, timeout_sec, env, stage)
+
+        env = dict(env if env is not None else os.environ)
+        gcov_prefix = env.pop("GCOV_PREFIX", "")
+        fd, log_path = tempfile.mkstemp(prefix=".cc1_", suffix=".log", dir=self.output_dir or str(src.parent))
+        os.close(fd)
+        start = time.time()
+        server = self._server(argv[0], env)
+        try:
+            status = server.run(argv, gcov_prefix, log_path, timeout_sec)
+            message = Path(log_path).read_text(encoding="utf-8", errors="replace")
+        except (OSError, EOFError) as e:
+            return False, f"Compilation error: fork server failed: {e}"
+        finally:
+            os.remove(log_path)
+        return self._result(str(src), options, stage, status, message,
+                            dict(server.last_usage, wall=time.time() - start), timeout_sec)
+
+    def close(self):
+        with self._lock:
+            servers, self._servers = self._servers, []
+        for server in servers:
+            server.close()
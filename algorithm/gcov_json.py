@@ -0,0 +1,41 @@
+import json
+import os
+from array import array
+from typing import Dict, IO, Iterator, Tuple
+
+from algorithm.gcov_reader import NOT_EXECUTABLE
+
+
+def iter_gcov_json(stream: IO[str]) -> Iterator[Dict]:
+    """
+    Stream the documents printed by `gcov --json-format --stdout` (one JSON document per input file and line),
+    without buffering the whole output.
+    """
+    for raw in stream:
+        raw = raw.strip()
+        if raw:
+            yield json.loads(raw)
+
+
+def json_line_counts(doc: Dict) -> Dict[str, Tuple[str, array]]:
+    """
+    Convert one gcov JSON document into compact per-file line counts.
+    Lines listed more than once (grouped functions such as template instantiations) are summed,
+    as in the top-level count of gcov's text output.
+    :return: {source name: (readable source path, array('q') indexed by line, -1 = not executable)}
+    """
+    cwd = doc.get("current_working_directory", "")
+    result: Dict[str, Tuple[str, array]] = {}
+    for entry in doc.get("files", []):
+        source = entry.get("file", "")
+        lines = entry.get("lines", [])
+        if not source or not lines:
+            continue
+        counts = array('q', [NOT_EXECUTABLE]) * (max(l["line_number"] for l in lines) + 1)
+        for l in lines:
+            ln = l["line_number"]
+            prev = counts[ln]
+            counts[ln] = l["count"] if prev < 0 else prev + l["count"]
+        path = source if os.path.isabs(source) else os.path.join(cwd, source)
+        result[source] = (path, counts)
+    return result
@@ -0,0 +1,98 @@
+import os
+from array import array
+from typing import List, Optional, Tuple
+
+from algorithm.gcov_reader import (DATA_MAGIC, TAG_COUNTER_ARCS, TAG_FUNCTION, TAG_OBJECT_SUMMARY,
+                                   GcovFormatError, _RecordReader)
+
+
+class GcdaProfile:
+    """
+    Counter records of one .gcda file, as written by libgcov for -fprofile-arcs (arc counters only).
+    Files with other counter kinds (value profiling) raise GcovFormatError and must be merged by gcov-tool.
+    """
+    def __init__(self, path: str):
+        with open(path, 'rb') as f:
+            r = _RecordReader(f.read(), DATA_MAGIC)
+        self.u32 = r.u32
+        self.header = r.data[:16]  # magic, version, stamp, checksum
+        r.pos = 16
+        self.runs = 0
+        self.sum_max = 0
+        self.functions: List[Tuple[Tuple[int, ...], Optional[array]]] = []  # [((ident, lineno_cs, cfg_cs), arcs)]
+        while not r.at_end():
+            tag = r.unsigned()
+            if not tag:
+                break
+            length = r.signed()
+            base = r.pos
+            if tag == TAG_OBJECT_SUMMARY:
+                self.runs = r.unsigned()
+                self.sum_max = r.unsigned()
+            elif tag == TAG_FUNCTION:
+                key = tuple(r.unsigned() for _ in range(max(length, 0) // 4))
+                self.functions.append((key, None))
+            elif tag == TAG_COUNTER_ARCS and self.functions and self.functions[-1][1] is None:
+                n = abs(length) // 8
+                counts = array('q', (r.counter() for _ in range(n))) if length > 0 else array('q', bytes(8 * n))
+                self.functions[-1] = (self.functions[-1][0], counts)
+            else:
+                raise GcovFormatError(f"unsupported record {tag:#010x} in {path}")
+            r.pos = base + max(length, 0)
+
+    def merge(self, other: "GcdaProfile"):
+        """Add other's counters into this profile (same object file and compilation required)."""
+        if other.header != self.header or [k for k, _ in other.functions] != [k for k, _ in self.functions]:
+            raise GcovFormatError("profiles come from different compilations")
+        self.runs += other.runs
+        self.sum_max += other.sum_max
+        for (_, mine), (_, theirs) in zip(self.functions, other.functions):
+            if mine is None or theirs is None:
+                if mine is not theirs:
+                    raise GcovFormatError("counter records differ")
+                continue
+            if len(mine) != len(theirs):
+                raise GcovFormatError("counter records differ")
+            for i, c in enumerate(theirs):
+                if c:
+                    mine[i] += c
+
+    def write(self, path: str):
+        """Write the profile atomically, all-zero counter records in libgcov's compact form."""
+        u32 = self.u32.pack
+        out = bytearray(self.header)
+        out += u32(TAG_OBJECT_SUMMARY) + u32(8) + u32(self.runs & 0xffffffff) + u32(self.sum_max & 0xffffffff)
+        for key, counts in self.functions:
+            out += u32(TAG_FUNCTION) + u32(4 * len(key))
+            for word in key:
+                out += u32(word)
+            if counts is None:
+                continue
+            if any(counts):
+                out += u32(TAG_COUNTER_ARCS) + u32(8 * len(counts))
+                for c in counts:
+                    c &= (1 << 64) - 1
+                    out += u32(c & 0xffffffff) + u32(c >> 32)
+            else:
+                out += u32(TAG_COUNTER_ARCS) + u32((-8 * len(counts)) & 0xffffffff)
+        out += u32(0)  # end of file
+        tmp = f"{path}.merge-{os.getpid()}"
+        with open(tmp, 'wb') as f:
+            f.write(out)
+        os.replace(tmp, path)
+
+
+def merge_gcda_files(sources: List[str], dest: str):
+    """
+    Sum the counters of sources (dest itself may be one of them) and write the result to dest.
+    Module level so it can run in a process pool.
+    :return: (dest, error message or None); on error dest is left untouched
+    """
+    try:
+        merged = GcdaProfile(sources[0])
+        for path in sources[1:]:
+            merged.merge(GcdaProfile(path))
+        merged.write(dest)
+        return dest, None
+    except (OSError, GcovFormatError) as e:
+        return dest, f"{type(e).__name__}: {e}"
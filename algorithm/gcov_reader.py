@@ -0,0 +1,462 @@
+import os
+import struct
+from array import array
+from typing import Dict, List, Optional, Tuple
+
+# Record tags (gcov-io.h)
+TAG_FUNCTION = 0x01000000
+TAG_BLOCKS = 0x01410000
+TAG_ARCS = 0x01430000
+TAG_LINES = 0x01450000
+TAG_COUNTER_ARCS = 0x01a10000
+TAG_OBJECT_SUMMARY = 0xa1000000
+
+ARC_ON_TREE = 1 << 0
+ARC_FAKE = 1 << 1
+ARC_FALLTHROUGH = 1 << 2
+
+NOTE_MAGIC = 0x67636e6f  # "gcno"
+DATA_MAGIC = 0x67636461  # "gcda"
+
+NOT_EXECUTABLE = -1
+
+
+class GcovFormatError(Exception):
+    pass
+
+
+class _RecordReader:
+    """
+    Sequential reader over a .gcno/.gcda buffer.
+    Since GCC 12 record lengths are in bytes and strings are stored unpadded
+    (int32:length-including-NUL followed by the bytes), so reads are not word aligned.
+    """
+    def __init__(self, data: bytes, magic: int):
+        self.data = data
+        self.pos = 0
+        if len(data) < 4:
+            raise GcovFormatError("file too short")
+        if struct.unpack_from('<I', data, 0)[0] == magic:
+            self.u32 = struct.Struct('<I')
+        elif struct.unpack_from('>I', data, 0)[0] == magic:
+            self.u32 = struct.Struct('>I')
+        else:
+            raise GcovFormatError("bad magic")
+
+    def at_end(self) -> bool:
+        return self.pos + 4 > len(self.data)
+
+    def unsigned(self) -> int:
+        v = self.u32.unpack_from(self.data, self.pos)[0]
+        self.pos += 4
+        return v
+
+    def signed(self) -> int:
+        v = self.unsigned()
+        return v - (1 << 32) if v & 0x80000000 else v
+
+    def counter(self) -> int:
+        lo = self.unsigned()
+        hi = self.unsigned()
+        v = (hi << 32) | lo
+        return v - (1 << 64) if v & (1 << 63) else v
+
+    def string(self) -> Optional[str]:
+        length = self.unsigned()
+        if not length:
+            return None
+        raw = self.data[self.pos:self.pos + length]
+        self.pos += length
+        return raw.rstrip(b'\0').decode('utf-8', errors='replace')
+
+
+class _Function:
+    __slots__ = ("ident", "cfg_checksum", "name", "source", "start_line", "start_column", "end_line",
+                 "n_blocks", "arcs", "block_lines", "counts", "is_group")
+
+    def __init__(self, ident: int, cfg_checksum: int, name: str, source: str):
+        self.ident = ident
+        self.cfg_checksum = cfg_checksum
+        self.name = name
+        self.source = source
+        self.start_line = 0
+        self.start_column = 0
+        self.end_line = 0
+        self.is_group = False
+        self.n_blocks = 0
+        self.arcs: List[List[int]] = []  # [src, dst, flags, count or None]
+        self.block_lines: Dict[int, List[Tuple[str, int]]] = {}
+        self.counts: Optional[List[int]] = None
+
+
+class GcovReader:
+    """
+    Native reader for GCC (>= 12, including GCC 14) .gcno/.gcda files.
+    Function:
+    - Parse the notes file (functions, blocks, arcs, lines)
+    - Parse the counter file (arc counters)
+    - Solve the flow graph and produce per-line execution counts in memory,
+      without running gcov or writing text files
+    Line counts follow gcov's default (non -a) counting, see _accumulate_lines.
+    """
+    def __init__(self, gcno_path: str, gcda_path: Optional[str] = None):
+        """
+        :param gcno_path: .gcno notes file
+        :param gcda_path: .gcda counter file (default: gcno_path with .gcda suffix); missing = never executed
+        """
+        self.gcno_path = gcno_path
+        self.gcda_path = gcda_path or os.path.splitext(gcno_path)[0] + ".gcda"
+        self.cwd = ""
+        self.runs = 0
+        self.functions: List[_Function] = []
+        self.line_counts: Dict[str, array] = {}  # {source name: array('q') indexed by line, -1 = not executable}
+        self._notes_arcs: Optional[List[List[Tuple[int, int, int]]]] = None
+
+    def read(self) -> Dict[str, array]:
+        self._read_notes()
+        self._read_counts()
+        self._mark_groups()
+        for fn in self.functions:
+            self._solve(fn)
+        self._accumulate_lines()
+        return self.line_counts
+
+    def recount(self, gcda_path: str) -> Dict[str, array]:
+        """
+        Compute line counts for another .gcda of the same notes file, parsing the notes only once
+        (e.g. one .gcda per compiled program when attributing coverage).
+        """
+        if self._notes_arcs is None:
+            self.functions = []
+            self._read_notes()
+            self._mark_groups()
+            self._notes_arcs = [[(a[0], a[1], a[2]) for a in fn.arcs] for fn in self.functions]
+        for fn, arcs in zip(self.functions, self._notes_arcs):
+            fn.arcs = [[src, dst, flags, None] for src, dst, flags in arcs]
+            fn.counts = None
+        self.gcda_path = gcda_path
+        self.runs = 0
+        self.line_counts = {}
+        self._read_counts()
+        for fn in self.functions:
+            self._solve(fn)
+        self._accumulate_lines()
+        return self.line_counts
+
+    def _read_notes(self):
+        with open(self.gcno_path, 'rb') as f:
+            r = _RecordReader(f.read(), NOTE_MAGIC)
+        r.unsigned()  # magic
+        r.unsigned()  # version
+        r.unsigned()  # stamp
+        r.unsigned()  # checksum
+        self.cwd = r.string() or ""
+        r.unsigned()  # supports has_unexecuted_blocks
+        fn = None
+        while not r.at_end():
+            tag = r.unsigned()
+            if not tag:
+                break
+            length = r.unsigned()
+            base = r.pos
+            if tag == TAG_FUNCTION:
+                ident = r.unsigned()
+                r.unsigned()  # lineno_checksum
+                cfg_checksum = r.unsigned()
+                name = r.string() or ""
+                r.unsigned()  # artificial
+                source = r.string() or ""
+                fn = _Function(ident, cfg_checksum, name, source)
+                fn.start_line = r.unsigned()
+                fn.start_column = r.unsigned()
+                fn.end_line = r.unsigned()
+                self.functions.append(fn)
+            elif fn is not None and tag == TAG_BLOCKS:
+                fn.n_blocks = r.unsigned()
+            elif fn is not None and tag == TAG_ARCS:
+                src = r.unsigned()
+                for _ in range((length // 4 - 1) // 2):
+                    dst = r.unsigned()
+                    flags = r.unsigned()
+                    fn.arcs.append([src, dst, flags, None])
+            elif fn is not None and tag == TAG_LINES:
+                block = r.unsigned()
+                lines = fn.block_lines.setdefault(block, [])
+                source = fn.source
+                while True:
+                    ln = r.unsigned()
+                    if ln:
+                        lines.append((source, ln))
+                        continue
+                    name = r.string()
+                    if name is None:
+                        break
+                    source = name
+            r.pos = base + length
+
+    def _read_counts(self):
+        if not os.path.isfile(self.gcda_path):
+            return
+        with open(self.gcda_path, 'rb') as f:
+            r = _RecordReader(f.read(), DATA_MAGIC)
+        r.unsigned()  # magic
+        r.unsigned()  # version
+        r.unsigned()  # stamp
+        r.unsigned()  # checksum
+        by_ident = {fn.ident: fn for fn in self.functions}
+        fn = None
+        while not r.at_end():
+            tag = r.unsigned()
+            if not tag:
+                break
+            length = r.signed()
+            base = r.pos
+            if tag == TAG_OBJECT_SUMMARY:
+                self.runs = r.unsigned()
+            elif tag == TAG_FUNCTION:
+                fn = None
+                if length > 0:
+                    ident = r.unsigned()
+                    r.unsigned()  # lineno_checksum
+                    cfg_checksum = r.unsigned()
+                    cand = by_ident.get(ident)
+                    if cand is not None and cand.cfg_checksum == cfg_checksum:
+                        fn = cand
+            elif tag == TAG_COUNTER_ARCS and fn is not None:
+                n = abs(length) // 8
+                counts = [r.counter() for _ in range(n)] if length > 0 else [0] * n
+                if fn.counts is None:
+                    fn.counts = counts
+                else:
+                    fn.counts = [a + b for a, b in zip(fn.counts, counts)]
+            r.pos = base + max(length, 0)
+
+    @staticmethod
+    def _solve(fn: _Function):
+        """
+        Assign measured counters to off-tree arcs (in block order) and derive the
+        remaining arc and block counts from flow conservation.
+        """
+        n = fn.n_blocks
+        if not n:
+            return
+        succ: List[List[List[int]]] = [[] for _ in range(n)]
+        pred: List[List[List[int]]] = [[] for _ in range(n)]
+        for arc in fn.arcs:
+            if arc[0] < n and arc[1] < n:
+                succ[arc[0]].append(arc)
+                pred[arc[1]].append(arc)
+        counts = iter(fn.counts or [])
+        for b in range(n):
+            for arc in succ[b]:
+                if not arc[2] & ARC_ON_TREE:
+                    arc[3] = next(counts, 0)
+        block_count: List[Optional[int]] = [None] * n
+        changed = True
+        while changed:
+            changed = False
+            for b in range(n):
+                ins, outs = pred[b], succ[b]
+                if block_count[b] is None:
+                    if ins and all(a[3] is not None for a in ins):
+                        block_count[b] = sum(a[3] for a in ins)
+                    elif outs and all(a[3] is not None for a in outs):
+                        block_count[b] = sum(a[3] for a in outs)
+                    elif not ins and not outs:
+                        block_count[b] = 0
+                    else:
+                        continue
+                    changed = True
+                total = block_count[b]
+                for side in (ins, outs):
+                    unknown = [a for a in side if a[3] is None]
+                    if len(unknown) == 1:
+                        unknown[0][3] = max(total - sum(a[3] for a in side if a[3] is not None), 0)
+                        changed = True
+        fn.counts = [c or 0 for c in block_count]
+        fn.arcs = [a for a in fn.arcs if a[3] is not None]
+
+    def _mark_groups(self):
+        """
+        Functions sharing (source, start line, start column) form a group (e.g. template
+        instantiations); gcov counts their lines per function and sums the results.
+        """
+        seen: Dict[Tuple[str, int, int], List[_Function]] = {}
+        for fn in self.functions:
+            seen.setdefault((fn.source, fn.start_line, fn.start_column), []).append(fn)
+        for fns in seen.values():
+            if len(fns) > 1:
+                for fn in fns:
+                    fn.is_group = True
+
+    def _accumulate_lines(self):
+        """
+        Per-line counts as computed by gcov (without -a):
+        - every line of a block is executable and accumulates the block count
+        - a block is attached to its highest line in the function's own source file;
+          for lines with attached blocks the count
+          is the sum of arcs entering those blocks from elsewhere plus the counts of
+          the elementary cycles entirely on that line
+        - lines inside a grouped function are counted per function, then summed
+        """
+        # bucket: (function index for group lines, else -1, (source, line))
+        totals: Dict[Tuple[int, Tuple[str, int]], int] = {}
+        attached: Dict[Tuple[int, Tuple[str, int]], List[Tuple[int, int]]] = {}
+        for fi, fn in enumerate(self.functions):
+            block_count = fn.counts or []
+            for block in sorted(fn.block_lines):
+                line = None
+                count = block_count[block] if block < len(block_count) else 0
+                for loc in fn.block_lines[block]:
+                    in_group = fn.is_group and loc[0] == fn.source and fn.start_line <= loc[1] <= fn.end_line
+                    key = (fi if in_group else -1, loc)
+                    totals[key] = totals.get(key, 0) + count
+                    if loc[0] == fn.source and (line is None or loc[1] > line[1][1]):
+                        line = key
+                # gcov skips the first and last block index (historical entry/exit positions)
+                if line is not None and 0 < block < fn.n_blocks - 1:
+                    attached.setdefault(line, []).append((fi, block))
+        succ: List[Dict[int, List[List[int]]]] = []
+        pred: List[Dict[int, List[List[int]]]] = []
+        for fn in self.functions:
+            s: Dict[int, List[List[int]]] = {}
+            p: Dict[int, List[List[int]]] = {}
+            for arc in fn.arcs:
+                s.setdefault(arc[0], []).append(arc)
+                p.setdefault(arc[1], []).append(arc)
+            succ.append(s)
+            pred.append(p)
+        for loc, blocks in attached.items():
+            on_line = set(blocks)
+            count = 0
+            for fi, b in blocks:
+                for arc in pred[fi].get(b, ()):
+                    if (fi, arc[0]) not in on_line:
+                        count += arc[3]
+            cs = {}
+            for fi, b in blocks:
+                for arc in succ[fi].get(b, ()):
+                    cs[id(arc)] = arc[3]
+            for fi, b in blocks:
+                count += self._cycles_from(fi, b, succ[fi], on_line, cs)
+            totals[loc] = count
+        lines_of: Dict[str, Dict[int, int]] = {}
+        for (_, (source, ln)), count in totals.items():
+            per_source = lines_of.setdefault(source, {})
+            per_source[ln] = per_source.get(ln, 0) + count
+        for source, lines in lines_of.items():
+            counts = array('q', [NOT_EXECUTABLE]) * (max(lines) + 1)
+            for ln, c in lines.items():
+                counts[ln] = c
+            self.line_counts[source] = counts
+
+    @staticmethod
+    def _cycles_from(fi: int, start: int, succ: Dict[int, List[List[int]]], on_line: set, cs: Dict[int, int]) -> int:
+        """
+        Johnson-style elementary circuit search rooted at start (gcov's get_cycles_count):
+        each cycle found adds its minimum remaining arc count, which is then consumed.
+        """
+        total = 0
+        path: List[List[int]] = []
+        blocked: List[int] = []
+        block_lists: List[List[int]] = []
+
+        def unblock(u: int):
+            idx = blocked.index(u)
+            blocked.pop(idx)
+            lst = block_lists.pop(idx)
+            for w in lst:
+                if w in blocked:
+                    unblock(w)
+
+        def circuit(v: int) -> bool:
+            nonlocal total
+            found = False
+            blocked.append(v)
+            block_lists.append([])
+            for arc in succ.get(v, ()):
+                w = arc[1]
+                if w < start or cs.get(id(arc), 0) <= 0 or (fi, w) not in on_line:
+                    continue
+                path.append(arc)
+                if w == start:
+                    cycle = min(cs[id(a)] for a in path)
+                    total += cycle
+                    for a in path:
+                        cs[id(a)] -= cycle
+                    found = True
+                elif w not in blocked:
+                    found |= circuit(w)
+                path.pop()
+            if found:
+                unblock(v)
+            else:
+                for arc in succ.get(v, ()):
+                    w = arc[1]
+                    if w < start or cs.get(id(arc), 0) <= 0 or (fi, w) not in on_line:
+                        continue
+                    lst = block_lists[blocked.index(w)]
+                    if v not in lst:
+                        lst.append(v)
+            return found
+
+        circuit(start)
+        return total
+
+    def resolve_source(self, source: str) -> str:
+        """Resolve a source name recorded in the notes file against the compilation directory."""
+        return source if os.path.isabs(source) else os.path.join(self.cwd, source)
+
+
+def summarize_counts(counts: array) -> Tuple[float, int]:
+    """
+    Return (percent of executed lines, executable lines), as in gcov's "Lines executed:" summary.
+    """
+    total = 0
+    executed = 0
+    for c in counts:
+        if c >= 0:
+            total += 1
+            if c > 0:
+                executed += 1
+    return (executed * 100.0 / total if total else 0.0), total
+
+
+def format_gcov(source: str, counts: array, source_path: Optional[str] = None,
+                graph: str = "", data: str = "", runs: int = 0) -> str:
+    """
+    Render per-line counts as gcov text ("count:line:code"), for consumers that still read .gcov files.
+    :param source: source name as recorded in the notes file
+    :param counts: per-line counts (-1 = not executable)
+    :param source_path: readable path of the source (default: source)
+    """
+    out = [
+        f"{'-':>9}:{0:>5}:Source:{source}",
+        f"{'-':>9}:{0:>5}:Graph:{graph}",
+        f"{'-':>9}:{0:>5}:Data:{data}",
+        f"{'-':>9}:{0:>5}:Runs:{runs}",
+    ]
+    try:
+        with open(source_path or source, 'r', encoding='utf-8', errors='replace') as f:
+            code_lines = f.read().split('\n')
+        if code_lines and code_lines[-1] == '':
+            code_lines.pop()
+    except OSError:
+        code_lines = []
+    n_lines = max(len(code_lines), len(counts) - 1)
+    for ln in range(1, n_lines + 1):
+        c = counts[ln] if ln < len(counts) else NOT_EXECUTABLE
+        mark = '-' if c < 0 else ('#####' if c == 0 else str(c))
+        code = code_lines[ln - 1] if ln <= len(code_lines) else "/*EOF*/"
+        out.append(f"{mark:>9}:{ln:>5}:{code}")
+    return "\n".join(out) + "\n"
+
+
+def read_translation_unit(gcno_path: str, gcda_path: Optional[str] = None):
+    """
+    Read one translation unit (picklable result, usable from a process pool)
+    :return: (cwd, runs, {source name: counts})
+    """
+    reader = GcovReader(gcno_path, gcda_path)
+    reader.read()
+    return reader.cwd, reader.runs, reader.line_counts
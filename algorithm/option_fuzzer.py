@@ -0,0 +1,184 @@
+import glob
+import json
+import os
+import random
+import re
+import shlex
+import subprocess
+from datetime import datetime
+from typing import Callable, Dict, List, Optional, Tuple
+
+from algorithm.compile_pool import CompileScheduler
+from algorithm.option_matrix import TargetProbe
+
+# Flags that need extra inputs, change the ABI of the runtime or only instrument: never mutated
+_SKIP_FLAGS = re.compile(r"^-f(no-)?(profile|auto-profile|branch-probabilities|instrument|split-stack|exceptions|"
+                         r"non-call-exceptions|asynchronous-unwind-tables|unwind-tables|live-patching|"
+                         r"patchable-function-entry|stack-protector|stack-check|cf-protection|sanitize)")
+_FLAG_RE = re.compile(r"^\s+(-f[\w+-]+)\s+\[(enabled|disabled)\]")
+_PARAM_RE = re.compile(r"^\s+--param=([\w-]+)=(?:<(-?\d+),(-?\d+)>|\[([^\]]+)\])?\s+(\S+)?")
+_BASE_LEVELS = ["-O1", "-O2", "-O3", "-Os"]
+
+
+class OptionSpace:
+    """
+    Mutable option space of one compiler, read from its own help output:
+    boolean -f flags (`-Q --help=optimizers`), --param values (`-Q --help=params`) and -march values.
+    """
+    def __init__(self, gcc_path: str):
+        self.gcc_path = gcc_path
+        self.flags: List[Tuple[str, bool]] = []  # (-fname, enabled at -O2)
+        self.params: Dict[str, Tuple[Optional[int], Optional[int], List[str], str]] = {}  # {name: (lo, hi, enum, default)}
+        self.marches: List[str] = []
+        self._load()
+
+    def _help(self, *args: str) -> str:
+        try:
+            res = subprocess.run([self.gcc_path, *args], stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                 encoding="utf-8", errors="replace", timeout=60)
+        except (OSError, subprocess.TimeoutExpired):
+            return ""
+        return res.stdout
+
+    def _load(self):
+        for line in self._help("-O2", "-Q", "--help=optimizers").splitlines():
+            m = _FLAG_RE.match(line)
+            if m and not _SKIP_FLAGS.match(m.group(1)):
+                self.flags.append((m.group(1), m.group(2) == "enabled"))
+        for line in self._help("-Q", "--help=params").splitlines():
+            m = _PARAM_RE.match(line)
+            if not m:
+                continue
+            name, lo, hi, enum, default = m.groups()
+            self.params[name] = (int(lo) if lo is not None else None, int(hi) if hi is not None else None,
+                                 enum.split("|") if enum else [], default or "")
+        lines = self._help("-Q", "--help=target").splitlines()
+        for i, line in enumerate(lines):
+            if "Known valid arguments for -march=" in line and i + 1 < len(lines):
+                self.marches = [m for m in lines[i + 1].split() if m != "native"]
+                break
+
+    def random_param(self, rng: random.Random) -> Optional[str]:
+        if not self.params:
+            return None
+        name = rng.choice(list(self.params))
+        lo, hi, enum, default = self.params[name]
+        if enum:
+            return f"--param={name}={rng.choice(enum)}"
+        base = int(default) if default.lstrip("-").isdigit() else 0
+        # Stay near the default: huge limits mostly buy compile time, not new code paths
+        low = lo if lo is not None else 0
+        high = min(hi if hi is not None else base * 4 + 16, max(base * 4, low + 16))
+        return f"--param={name}={rng.randint(low, max(low, high))}"
+
+    def mutate(self, options: str, rng: random.Random, max_mutations: int = 3) -> str:
+        """Apply 1..max_mutations random edits: flip a flag, set a param, change -march or the -O level."""
+        args = shlex.split(options)
+        for _ in range(rng.randint(1, max_mutations)):
+            kind = rng.random()
+            if kind < 0.6 and self.flags:
+                flag, enabled = rng.choice(self.flags)
+                name = flag[len("-fno-"):] if flag.startswith("-fno-") else flag[len("-f"):]
+                args = [a for a in args if a not in (f"-f{name}", f"-fno-{name}")]
+                args.append(f"-fno-{name}" if enabled else f"-f{name}")
+            elif kind < 0.85:
+                param = self.random_param(rng)
+                if param is not None:
+                    prefix = param.rsplit("=", 1)[0] + "="
+                    args = [a for a in args if not a.startswith(prefix)] + [param]
+            elif kind < 0.95 and self.marches:
+                args = [a for a in args if not a.startswith("-march=")] + [f"-march={rng.choice(self.marches)}"]
+            else:
+                args = [rng.choice(_BASE_LEVELS)] + [a for a in args if not re.match(r"^-O(\d|s|fast|g|z)?$", a)]
+        return " ".join(shlex.quote(a) for a in args)
+
+
+class OptionFuzzer:
+    """
+    LLM-free coverage mode: recompile programs of the existing corpus (OUTPUT_DIR/batch_*/*.c) under random
+    mutations of option sets, keeping every combination that covers new lines of the target file as a
+    parent for later mutations (per target file, persisted in a JSON-lines log).
+    """
+    def __init__(self, compiler: CompileScheduler, corpus_dir: str, gcc_path: str, probe: TargetProbe,
+                 log_path: Optional[str] = None, programs_per_round: int = 16, seed: Optional[int] = None):
+        """
+        :param compiler: scheduler the compiles run on
+        :param corpus_dir: directory holding the batch_* folders of generated programs
+        :param gcc_path: instrumented compiler (its help output defines the option space)
+        :param probe: reads the target file's current coverage
+        :param log_path: JSON-lines file of the kept combinations (also reloaded as seeds)
+        :param programs_per_round: corpus programs compiled per option combination
+        """
+        self.compiler = compiler
+        self.corpus_dir = corpus_dir
+        self.gcc_path = gcc_path
+        self.probe = probe
+        self.log_path = log_path
+        self.programs_per_round = programs_per_round
+        self.rng = random.Random(seed)
+        self._space: Optional[OptionSpace] = None
+        self.kept: Dict[str, List[str]] = {}  # {target basename: option sets that covered new lines}
+        self.stats = {"rounds": 0, "kept": 0, "new_lines": 0}
+        self._load_log()
+
+    @property
+    def space(self) -> OptionSpace:
+        if self._space is None:
+            self._space = OptionSpace(self.gcc_path)
+        return self._space
+
+    def _load_log(self):
+        if not self.log_path or not os.path.isfile(self.log_path):
+            return
+        with open(self.log_path, encoding="utf-8") as f:
+            for line in f:
+                try:
+                    entry = json.loads(line)
+                except ValueError:
+                    continue
+                self.kept.setdefault(entry.get("target", ""), []).append(entry.get("options", ""))
+
+    def _log(self, entry: Dict):
+        if not self.log_path:
+            return
+        with open(self.log_path, "a", encoding="utf-8") as f:
+            f.write(json.dumps(entry) + "\n")
+
+    def corpus(self) -> List[str]:
+        return sorted(glob.glob(os.path.join(self.corpus_dir, "batch_*", "*.c")))
+
+    def run(self, target_file: str, rounds: int, stage_for: Optional[Callable[[str], Optional[str]]] = None) -> int:
+        """
+        Fuzz option combinations for target_file.
+        :param rounds: option combinations to try (each compiles programs_per_round corpus programs)
+        :param stage_for: options -> stage to compile up to (see stage_map.py), None = linked executable
+        :return: number of newly covered lines of the target file
+        """
+        base_name = os.path.basename(target_file.replace("\\", "/"))
+        programs = self.corpus()
+        if not programs:
+            print("  [Fuzz] Empty corpus")
+            return 0
+        parents = self.kept.setdefault(base_name, [])
+        covered = self.probe.covered_mask(base_name)
+        gained_total = 0
+        for _ in range(rounds):
+            parent = self.rng.choice(parents) if parents and self.rng.random() < 0.7 else self.rng.choice(_BASE_LEVELS)
+            options = self.space.mutate(parent, self.rng)
+            sample = self.rng.sample(programs, min(self.programs_per_round, len(programs)))
+            self.compiler.run(sample, options, self.gcc_path, stage=stage_for(options) if stage_for else None)
+            after = self.probe.covered_mask(base_name)
+            gained = bin(after & ~covered).count("1")
+            covered = after
+            self.stats["rounds"] += 1
+            if gained:
+                parents.append(options)
+                gained_total += gained
+                self.stats["kept"] += 1
+                self.stats["new_lines"] += gained
+                self._log({"target": base_name, "options": options, "new_lines": gained,
+                           "time": datetime.now().isoformat(timespec="seconds")})
+                print(f"  [Fuzz] +{gained} lines in {base_name}: {options}")
+        print(f"  [Fuzz] {rounds} combinations on {base_name}: +{gained_total} lines "
+              f"({len(parents)} kept combinations)")
+        return gained_total
@@ -0,0 +1,172 @@
+import os
+import shlex
+from array import array
+from pathlib import Path
+from typing import Callable, Dict, Iterable, List, Optional, Tuple
+
+from algorithm.compile_pool import CompileScheduler
+from algorithm.coverage_snapshot import FileCoverage
+from algorithm.gcov_reader import GcovFormatError, GcovReader
+
+# Extra option sets tried on every program after the summarizer's options
+DEFAULT_OPTION_MATRIX = [
+    "-O0",
+    "-O1",
+    "-O2",
+    "-O3",
+    "-Os",
+    "-O2 -ffast-math",
+    "-O3 -fno-tree-vectorize",
+    "-O2 -fno-tree-pre -fno-tree-fre",
+    "-O2 -fno-tree-dominator-opts -fno-tree-vrp",
+    "-O2 -fno-tree-loop-optimize -fno-tree-ch",
+]
+
+
+def _option_key(options: str) -> str:
+    try:
+        return " ".join(shlex.split(options))
+    except ValueError:
+        return options.strip()
+
+
+class OptionMatrixRunner:
+    """
+    Compile every generated program under many option sets while preprocessing it only once.
+    The programs are first preprocessed (in parallel, "preprocess" stage) into .i files with the primary
+    options; each further option set is then one parallel CompileScheduler round over the .i files, which
+    the driver compiles with -fpreprocessed. Rounds stop early once is_covered() reports the target block.
+    Macros that depend on the options (__OPTIMIZE__, __FAST_MATH__, ...) keep their primary-option values.
+    """
+    def __init__(self, compiler: CompileScheduler, matrix: Optional[List[str]] = None, max_rounds: Optional[int] = None):
+        """
+        :param compiler: scheduler the rounds run on (its compile_fn, workers and profile folding)
+        :param matrix: option sets tried after the extracted ones (default: DEFAULT_OPTION_MATRIX)
+        :param max_rounds: cap on the number of extra option sets per batch (None = all)
+        """
+        self.compiler = compiler
+        self.matrix = DEFAULT_OPTION_MATRIX if matrix is None else matrix
+        self.max_rounds = max_rounds
+        self.last_run_stats: List[Dict] = []
+
+    def option_sets(self, primary: str, extracted: Iterable[str] = ()) -> List[str]:
+        """Extracted option sets, then the matrix, without duplicates or the primary options; capped."""
+        seen = {_option_key(primary)}
+        result = []
+        for options in list(extracted) + list(self.matrix):
+            key = _option_key(options)
+            if key and key not in seen:
+                seen.add(key)
+                result.append(options)
+        return result if self.max_rounds is None else result[:self.max_rounds]
+
+    def preprocess(self, program_paths: List[str], compile_options: str, gcc_path: Optional[str]) -> List[str]:
+        """
+        Write <program>.i for every program (the preprocessor's counters are folded like any compile).
+        :return: paths of the .i files that were produced
+        """
+        results = self.compiler.run(program_paths, compile_options, gcc_path, stage="preprocess")
+        outputs = []
+        for path, success, _ in results:
+            i_path = str(Path(path).with_suffix(".i"))
+            if success and os.path.isfile(i_path):
+                outputs.append(i_path)
+        return outputs
+
+    def run(self, program_paths: List[str], primary: str, extracted: Iterable[str], gcc_path: Optional[str],
+            stage_for: Optional[Callable[[str], Optional[str]]] = None,
+            before_fold_for: Optional[Callable[[str], Optional[Callable]]] = None,
+            is_covered: Optional[Callable[[], bool]] = None) -> List[Dict]:
+        """
+        Compile the programs under every further option set until the target block is covered.
+        :param primary: options the programs were already compiled with (also used for preprocessing)
+        :param extracted: option sets extracted from the prompt (tried before the matrix)
+        :param stage_for: options -> stage to compile up to (see stage_map.py), None = linked executable
+        :param before_fold_for: options -> CompileScheduler before_fold callback for that round
+        :param is_covered: checked after every round; True stops the remaining rounds
+        :return: [{"options", "programs", "failed", "covered"}] per round
+        """
+        self.last_run_stats = []
+        option_sets = self.option_sets(primary, extracted)
+        if not option_sets or not program_paths:
+            return self.last_run_stats
+        i_files = self.preprocess(program_paths, primary, gcc_path)
+        if not i_files:
+            return self.last_run_stats
+
+        for options in option_sets:
+            results = self.compiler.run(i_files, options, gcc_path,
+                                        before_fold=before_fold_for(options) if before_fold_for else None,
+                                        stage=stage_for(options) if stage_for else None)
+            covered = bool(is_covered and is_covered())
+            self.last_run_stats.append({
+                "options": options,
+                "programs": len(results),
+                "failed": sum(1 for _, success, _ in results if not success),
+                "covered": covered,
+            })
+            print(f"  [Matrix] {options}: {len(results) - self.last_run_stats[-1]['failed']}/{len(results)} compiled"
+                  f"{', target covered' if covered else ''}")
+            if covered:
+                break
+        return self.last_run_stats
+
+
+class TargetProbe:
+    """
+    Cheap check whether given lines of one compiler source file are covered, read natively from the
+    .gcno/.gcda pair of its translation unit (no gcov run, notes parsed once per file).
+    """
+    def __init__(self, source_dirs: List[str]):
+        """
+        :param source_dirs: .gcda/.gcno directories (as for GcovRunner)
+        """
+        self.source_dirs = source_dirs
+        self._notes: Dict[str, Optional[str]] = {}  # {source basename: .gcno path}
+        self._readers: Dict[str, Tuple[int, GcovReader]] = {}
+
+    def _find_notes(self, base_name: str) -> Optional[str]:
+        if base_name not in self._notes:
+            stem = os.path.splitext(base_name)[0]
+            found = None
+            for src_dir in self.source_dirs:
+                candidate = os.path.join(src_dir, stem + ".gcno")
+                if os.path.isfile(candidate):
+                    found = candidate
+                    break
+            self._notes[base_name] = found
+        return self._notes[base_name]
+
+    def line_counts(self, base_name: str) -> Optional[array]:
+        """Current per-line counts of base_name (-1 = not executable), or None if it has no profile."""
+        gcno = self._find_notes(base_name)
+        if gcno is None:
+            return None
+        gcda = gcno[:-len(".gcno")] + ".gcda"
+        if not os.path.isfile(gcda):
+            return None
+        try:
+            mtime = os.stat(gcno).st_mtime_ns
+            cached = self._readers.get(gcno)
+            if cached is None or cached[0] != mtime:
+                cached = (mtime, GcovReader(gcno))
+                self._readers[gcno] = cached
+            counts_by_source = cached[1].recount(gcda)
+        except (OSError, GcovFormatError):
+            return None
+        for source, counts in counts_by_source.items():
+            if os.path.basename(source) == base_name:
+                return counts
+        return None
+
+    def covered(self, base_name: str, lines: Iterable[int]) -> bool:
+        """True if any of the lines of base_name has a non-zero count."""
+        counts = self.line_counts(base_name)
+        if counts is None:
+            return False
+        return any(0 < line < len(counts) and counts[line] > 0 for line in lines)
+
+    def covered_mask(self, base_name: str) -> int:
+        """Bitset of the covered lines of base_name (0 if it has no profile)."""
+        counts = self.line_counts(base_name)
+        return FileCoverage.from_counts(base_name, counts).covered if counts is not None else 0
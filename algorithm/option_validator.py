@@ -0,0 +1,239 @@
+import difflib
+import json
+import os
+import re
+import shlex
+import subprocess
+import tempfile
+import threading
+from collections import Counter
+from datetime import datetime
+from typing import Dict, List, Optional, Tuple
+
+# "  -fira-region=[one|all|mixed] 	one", "  --param=align-threshold=<1,65536> 	100", "  -mavx2   [disabled]"
+_HELP_LINE = re.compile(r"^\s+(--param=[\w-]+=|-[\w+.-]+=?)(?:<(-?\d+),(-?\d+)>|\[([^\]]+)\])?(?:\s|$)")
+_VALID_ARGS = re.compile(r"^\s+(?:Known valid arguments for|Valid arguments to) (-[\w-]+=)")
+_HELP_CLASSES = ["optimizers", "target", "params", "common", "c", "warnings"]
+# Options taking their argument as the next token
+_SEPARATE_ARG = {"-D", "-U", "-I", "-include", "-imacros", "-isystem", "-iquote", "-idirafter", "--param"}
+_DROPPED = {"-o", "-c", "-S", "-E", "-x"}  # set by compile_program / the stage, never by the LLM
+# Never checked: preprocessor definitions and include paths
+_PASS_THROUGH = re.compile(r"^-(D|U|I)\S")
+
+
+class OptionValidator:
+    """
+    Validates and normalizes option strings (e.g. from the LLM summary) against the instrumented GCC before
+    any compile, so one unsupported flag does not fail a whole batch.
+    An index of accepted options is read once from `gcc -Q --help=<class>` (optimizers, target, params,
+    common, c, warnings), including --param ranges and the valid values of enumerated options such as
+    -march=. Options missing from the index are probed once with `gcc <option> -fsyntax-only`.
+    Unknown options are corrected to a close match when there is one (e.g. -funrol-loops) and dropped
+    otherwise; out-of-range --param values are clamped. Every drop/correction is recorded.
+    """
+    def __init__(self, gcc_path: str, rejections_path: Optional[str] = None, timeout_sec: int = 30):
+        """
+        :param gcc_path: instrumented compiler whose options are accepted
+        :param rejections_path: JSON-lines log of the dropped and corrected options (None = not written)
+        :param timeout_sec: timeout of one help query or probe
+        """
+        self.gcc_path = gcc_path
+        self.rejections_path = rejections_path
+        self.timeout_sec = timeout_sec
+        self._options: Dict[str, Tuple[Optional[int], Optional[int]]] = {}  # {option or "-opt=": (lo, hi)}
+        self._values: Dict[str, List[str]] = {}  # {"-opt=": valid values}
+        self._probed: Dict[str, bool] = {}
+        self._loaded = False
+        self._lock = threading.Lock()
+        self.rejected: Counter = Counter()
+        self.corrected: Counter = Counter()
+
+    def _gcc(self, args: List[str]) -> Tuple[int, str, str]:
+        # The compiler is instrumented: keep the counters of these runs out of the real profiles
+        with tempfile.TemporaryDirectory(prefix=".option_probe_") as prefix:
+            env = dict(os.environ, GCOV_PREFIX=prefix, LC_ALL="C")
+            try:
+                res = subprocess.run([self.gcc_path, *args], stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                     encoding="utf-8", errors="replace", timeout=self.timeout_sec, env=env)
+            except (OSError, subprocess.TimeoutExpired) as e:
+                return -1, "", str(e)
+        return res.returncode, res.stdout, res.stderr
+
+    def _load(self):
+        for help_class in _HELP_CLASSES:
+            lines = self._gcc(["-Q", f"--help={help_class}"])[1].splitlines()
+            for i, line in enumerate(lines):
+                m = _VALID_ARGS.match(line)
+                if m:
+                    values = []
+                    for follow in lines[i + 1:]:
+                        if not follow.strip():
+                            break
+                        values.extend(follow.split())
+                    self._values[m.group(1)] = values
+                    continue
+                m = _HELP_LINE.match(line)
+                if not m:
+                    continue
+                name, lo, hi, enum = m.groups()
+                self._options[name] = (int(lo) if lo is not None else None, int(hi) if hi is not None else None)
+                if enum and "|" in enum:
+                    self._values[name] = enum.split("|")
+        self._loaded = True
+
+    def _probe(self, option: str) -> bool:
+        """Whether the compiler accepts option on its own (cached)."""
+        with self._lock:
+            if option in self._probed:
+                return self._probed[option]
+        code, _, stderr = self._gcc([option, "-fsyntax-only", "-x", "c", os.devnull])
+        accepted = code == 0 and "command-line option" not in stderr and "ignored" not in stderr
+        with self._lock:
+            self._probed[option] = accepted
+        return accepted
+
+    @staticmethod
+    def _positive(option: str) -> str:
+        """-fno-x / -mno-x / -Wno-x -> -fx / -mx / -Wx (the form listed by --help)."""
+        m = re.match(r"^-([fmW])no-(.+)$", option)
+        return f"-{m.group(1)}{m.group(2)}" if m else option
+
+    def _close(self, word: str, candidates: List[str]) -> Optional[str]:
+        match = difflib.get_close_matches(word, candidates, n=1, cutoff=0.85)
+        return match[0] if match else None
+
+    def check(self, option: str) -> Tuple[Optional[str], str]:
+        """
+        Validate one option.
+        :return: (option to use or None to drop it, "ok" | "corrected" | "rejected")
+        """
+        if not self._loaded:
+            with self._lock:
+                if not self._loaded:
+                    self._load()
+        if _PASS_THROUGH.match(option):
+            return option, "ok"
+        if option.startswith("--param="):
+            return self._check_param(option)
+
+        key, eq, value = option.partition("=")
+        key = self._positive(key) + eq
+        if key in self._options:
+            if not eq:
+                return option, "ok"
+            valid = self._value_ok(key, value)
+            if valid:
+                return option, "ok"
+            fixed = self._close(value, self._values.get(key, []))
+            if fixed is not None:
+                return f"{option.partition('=')[0]}={fixed}", "corrected"
+            # Free-form value (e.g. -falign-functions=32 or a target's -mcpu=): the compiler decides
+            return (option, "ok") if valid is None and self._probe(option) else (None, "rejected")
+        if self._probe(option):
+            return option, "ok"
+        # Misspelled flag: the closest indexed option of the same kind, if the compiler takes it
+        negative = self._positive(option.partition("=")[0]) != option.partition("=")[0]
+        family = [o for o in self._options if o[:2] == key[:2] and o.endswith("=") == bool(eq)]
+        fixed = self._close(key, family)
+        if fixed is not None:
+            if negative:
+                fixed = f"{fixed[:2]}no-{fixed[2:]}"
+            candidate = fixed + value if eq else fixed
+            if self._probe(candidate):
+                return candidate, "corrected"
+        return None, "rejected"
+
+    def _value_ok(self, key: str, value: str) -> Optional[bool]:
+        """Whether value is valid for key per the index; None if the index does not constrain it."""
+        if key in self._values:
+            return value in self._values[key]
+        lo, hi = self._options[key]
+        if lo is not None and hi is not None:
+            return value.lstrip("-").isdigit() and lo <= int(value) <= hi
+        return None
+
+    def _check_param(self, option: str) -> Tuple[Optional[str], str]:
+        name, _, value = option[len("--param="):].partition("=")
+        key = f"--param={name}="
+        if key not in self._options:
+            fixed = self._close(key, [o for o in self._options if o.startswith("--param=")])
+            if fixed is None:
+                return None, "rejected"
+            key, name = fixed, fixed[len("--param="):-1]
+        corrected = option != f"--param={name}={value}"
+        if key in self._values:
+            if value not in self._values[key]:
+                return None, "rejected"
+            return f"--param={name}={value}", "corrected" if corrected else "ok"
+        if not value.lstrip("-").isdigit():
+            return None, "rejected"
+        lo, hi = self._options[key]
+        if lo is None and hi is None and not self._probe(f"--param={name}={value}"):
+            return None, "rejected"  # no range in the help output: the compiler decides
+        clamped = int(value)
+        if lo is not None:
+            clamped = max(lo, clamped)
+        if hi is not None:
+            clamped = min(hi, clamped)
+        corrected = corrected or clamped != int(value)
+        return f"--param={name}={clamped}", "corrected" if corrected else "ok"
+
+    def validate(self, options: str) -> str:
+        """
+        Normalized option string with unsupported options corrected or dropped (may be empty).
+        """
+        try:
+            args = shlex.split(options or "")
+        except ValueError:
+            args = (options or "").split()
+        tokens: List[str] = []
+        i = 0
+        while i < len(args):
+            arg = args[i]
+            if arg in _SEPARATE_ARG and i + 1 < len(args):
+                tokens.append(f"--param={args[i + 1]}" if arg == "--param" else f"{arg}{args[i + 1]}"
+                              if arg in ("-D", "-U", "-I") else f"{arg} {args[i + 1]}")
+                i += 2
+                continue
+            if arg in _DROPPED:
+                i += 2 if arg in ("-o", "-x") else 1
+                continue
+            tokens.append(arg)
+            i += 1
+
+        kept: List[str] = []
+        dropped: List[str] = []
+        corrections: Dict[str, str] = {}
+        for token in tokens:
+            if " " in token:  # -include <file> and friends: not the LLM's business
+                dropped.append(token)
+                continue
+            result, status = self.check(token)
+            if result is None:
+                dropped.append(token)
+            else:
+                if status == "corrected":
+                    corrections[token] = result
+                if result not in kept:
+                    kept.append(result)
+        if dropped or corrections:
+            self._record(options, dropped, corrections)
+        return " ".join(shlex.quote(o) for o in kept)
+
+    def _record(self, options: str, dropped: List[str], corrections: Dict[str, str]):
+        with self._lock:
+            self.rejected.update(dropped)
+            self.corrected.update(f"{old} -> {new}" for old, new in corrections.items())
+        print(f"  [Options] {options!r}: dropped {dropped}, corrected {corrections}")
+        if not self.rejections_path:
+            return
+        entry = {"time": datetime.now().isoformat(timespec="seconds"), "options": options,
+                 "dropped": dropped, "corrected": corrections}
+        with self._lock, open(self.rejections_path, "a", encoding="utf-8") as f:
+            f.write(json.dumps(entry) + "\n")
+
+    def summary(self) -> str:
+        with self._lock:
+            top = ", ".join(f"{o} x{n}" for o, n in self.rejected.most_common(5))
+            return (f"{sum(self.rejected.values())} options dropped, {sum(self.corrected.values())} corrected"
+                    + (f" (most dropped: {top})" if top else ""))
@@ -0,0 +1,266 @@
+import os
+import re
+import shlex
+import subprocess
+import threading
+from concurrent.futures import ThreadPoolExecutor
+from pathlib import Path
+from typing import Dict, List, Optional, Set, Tuple
+
+# GCC 14 rejects these by default; the (older) host compiler has to be told so to flag the same programs
+_STRICT_FLAGS = ["-Werror=implicit-function-declaration", "-Werror=implicit-int", "-Werror=int-conversion",
+                 "-Werror=incompatible-pointer-types"]
+# Options of the target compile that change what the host compiler accepts; everything else is dropped
+# (the host compiler may not know newer optimization flags)
+_HOST_OPTION = re.compile(r"^(-std=|-ansi$|-D|-U|-I|-fopenmp$|-f(un)?signed-char$|-m32$|-m64$)")
+# Standards newer than the host compiler may be: their names before GCC 14 (c2x is still accepted after it)
+_HOST_STD = {"c23": "c2x", "gnu23": "gnu2x", "iso9899:2024": "c2x", "c2y": "c2x", "gnu2y": "gnu2x"}
+_DIAG = re.compile(r"^(.*?):(\d+):(\d+): (error|fatal error|warning|note): (.*)$")
+# "gcc: error: unrecognized command-line option ...", "cc1: fatal error: ...": not about the program's code
+_DRIVER_ERROR = re.compile(r"^[\w.+-]+: (?:fatal )?error: (.*)$")
+# "include '<math.h>' or provide a declaration of 'sqrt'", "did you forget to '#include <limits.h>'?"
+_HEADER_HINT = re.compile(r"(?:include '<|#include <)([\w./+-]+)>")
+_IMPLICIT = re.compile(r"implicit declaration of function '(\w+)'")
+_FENCE = re.compile(r"^\s*```")
+# Builtin families the target GCC provides and an older host may lack: never stubbed
+_TARGET_BUILTIN = re.compile(r"^__(builtin|atomic|sync)_")
+_C_WORDS = {"auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum",
+            "extern", "float", "for", "goto", "if", "inline", "int", "long", "register", "restrict", "return",
+            "short", "signed", "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void",
+            "volatile", "while", "_Bool", "_Complex", "bool"}
+
+
+def _host_options(options: str) -> List[str]:
+    try:
+        args = shlex.split(options)
+    except ValueError:
+        return []
+    kept = []
+    for i, arg in enumerate(args):
+        if _HOST_OPTION.match(arg):
+            if arg.startswith("-std="):
+                arg = "-std=" + _HOST_STD.get(arg[5:], arg[5:])
+            kept.append(arg)
+            if arg in ("-D", "-U", "-I") and i + 1 < len(args):
+                kept.append(args[i + 1])
+    return kept
+
+
+def host_check(host_cc: str, program_path: str, options: str = "",
+               timeout_sec: int = 30) -> Tuple[bool, List[Tuple[int, str, str]]]:
+    """
+    Syntax-check one program with the host compiler, as strict as the instrumented GCC.
+    :return: (success, [(line, kind, message)] diagnostics of the program file itself, plus driver errors
+             such as unknown options as line 0 errors)
+    """
+    cmd = [host_cc, "-fsyntax-only", "-fdiagnostics-plain-output", *_STRICT_FLAGS, *_host_options(options),
+           program_path]
+    try:
+        # C locale: plain ASCII quotes in the messages the fixes are matched against
+        res = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8",
+                             errors="replace", timeout=timeout_sec, env={**os.environ, "LC_ALL": "C"})
+    except subprocess.TimeoutExpired:
+        return False, [(0, "error", f"host compiler timeout (> {timeout_sec}s)")]
+    except OSError as e:
+        return False, [(0, "error", f"host compiler failed: {e}")]
+    diags = []
+    for line in res.stderr.splitlines():
+        m = _DIAG.match(line)
+        if m and Path(m.group(1)).name == Path(program_path).name:
+            diags.append((int(m.group(2)), "error" if m.group(4) == "fatal error" else m.group(4), m.group(5)))
+            continue
+        m = _DRIVER_ERROR.match(line)
+        if m:
+            diags.append((0, "error", m.group(1)))
+    return res.returncode == 0, diags
+
+
+def host_unsure(diags: List[Tuple[int, str, str]]) -> bool:
+    """
+    Whether a failed host_check says nothing about the program: the host compiler itself failed (driver
+    error, unknown option, timeout), reported no error in the program, or only lacks builtins of the
+    newer target GCC (implicit declarations of builtins such as __builtin_stdc_bit_width).
+    """
+    errors = [(line, message) for line, kind, message in diags if kind == "error"]
+    if not errors or any(line == 0 for line, _ in errors):
+        return True
+    return all(m and _TARGET_BUILTIN.match(m.group(1)) for m in (_IMPLICIT.search(message) for _, message in errors))
+
+
+def format_errors(diags: List[Tuple[int, str, str]]) -> str:
+    """'<line>: error: <message>' lines of the errors among host_check diagnostics."""
+    return "\n".join(f"{line}: {kind}: {message}" for line, kind, message in diags if kind == "error")
+
+
+def split_results(program_paths: List[str],
+                  results: List[Tuple[str, Optional[str]]]) -> Tuple[List[str], List[Tuple[str, str]]]:
+    """
+    Split the (status, diagnostics) of a checked batch.
+    :return: (programs to compile with the instrumented GCC, [(rejected program, host diagnostics)])
+    """
+    forward, rejected = [], []
+    for path, (status, message) in zip(program_paths, results):
+        if status == "rejected":
+            rejected.append((path, message or "host compiler rejected the program"))
+        else:
+            forward.append(path)
+    return forward, rejected
+
+
+def _is_prose(line: str) -> bool:
+    """Natural-language line left over from the LLM answer (or a markdown fence)."""
+    text = line.strip()
+    if _FENCE.match(text):
+        return True
+    if not text or re.search(r"[;{}=#\[\]]|/[/*]|\*/", text):
+        return False
+    words = text.split()
+    return (len(words) >= 3 and words[0].rstrip(":,") not in _C_WORDS and re.match(r"^[A-Za-z]", text)
+            is not None and not re.search(r"\w\s*\(.*\)\s*$", text))
+
+
+class ProgramRepairer:
+    """
+    Deterministic repair of generated programs with the (uninstrumented) host compiler, run before the
+    instrumented GCC sees them. Diagnostics of `gcc -fsyntax-only` are classified and fixed in place:
+      - missing headers: the header GCC suggests ("include '<math.h>'", "#include <stdbool.h>") is added
+      - functions called before their definition: a prototype is added
+      - implicit declarations without a known header (e.g. __ssdiv): a static int stub is defined; GCC
+        builtins (__builtin_*, __atomic_*, __sync_*) are left alone, the target GCC may know them
+      - prose and markdown fences around the code: those lines are removed
+    Programs that still do not compile after max_attempts rounds (or have other errors) are rejected;
+    programs the host compiler cannot judge (see host_unsure) are forwarded unchecked.
+    """
+    def __init__(self, host_cc: str = "gcc", max_attempts: int = 4, timeout_sec: int = 30,
+                 max_workers: Optional[int] = None):
+        """
+        :param host_cc: host C compiler used for the checks (fast, not instrumented)
+        :param max_attempts: check/fix rounds per program
+        :param timeout_sec: timeout of one host compiler check
+        :param max_workers: programs checked concurrently (default: ThreadPoolExecutor default)
+        """
+        self.host_cc = host_cc
+        self.max_attempts = max_attempts
+        self.timeout_sec = timeout_sec
+        self.max_workers = max_workers
+        self._lock = threading.Lock()
+        self.stats = {"clean": 0, "repaired": 0, "unchecked": 0, "rejected": 0, "missing_include": 0, "implicit_declaration": 0,
+                      "prose": 0}
+
+    def check(self, program_path: str, options: str = "") -> Tuple[bool, List[Tuple[int, str, str]]]:
+        """Syntax-check one program with the host compiler (see host_check)."""
+        return host_check(self.host_cc, program_path, options, self.timeout_sec)
+
+    @staticmethod
+    def fix(code: str, diags: List[Tuple[int, str, str]]) -> Tuple[str, Dict[str, int]]:
+        """
+        Apply the fixes the diagnostics call for.
+        :return: (new code, {fix category: count}); the code is unchanged if nothing applies
+        """
+        lines = code.split("\n")
+        fixes = {"missing_include": 0, "implicit_declaration": 0, "prose": 0}
+        headers: List[str] = []
+        hinted: Set[str] = set()
+        implicit: List[str] = []
+        drop: Set[int] = set()
+        for line_no, kind, message in diags:
+            m = _HEADER_HINT.search(message)
+            if m:
+                if m.group(1) not in headers:
+                    headers.append(m.group(1))
+                name = re.search(r"declaration of '(\w+)'|'(\w+)' is defined in header", message)
+                if name:
+                    hinted.add(name.group(1) or name.group(2))
+                continue
+            m = _IMPLICIT.search(message)
+            if m and kind == "error":
+                if not _TARGET_BUILTIN.match(m.group(1)):
+                    implicit.append(m.group(1))
+                continue
+            if kind == "error" and 0 < line_no <= len(lines) and _is_prose(lines[line_no - 1]):
+                drop.add(line_no - 1)
+
+        present = set(re.findall(r"^\s*#\s*include\s*<([^>]+)>", code, re.MULTILINE))
+        headers = [h for h in headers if h not in present]
+        stubs = []
+        for name in dict.fromkeys(implicit):
+            if name in hinted:
+                continue
+            # Called before its definition: forward-declare it; otherwise (e.g. a made-up builtin) stub it
+            definition = re.search(rf"^([A-Za-z_][\w\s*]*\b{re.escape(name)}\s*\([^;{{}}]*\))\s*\{{", code,
+                                   re.MULTILINE)
+            if definition:
+                stubs.append(" ".join(definition.group(1).split()) + ";")
+            else:
+                stubs.append(f"static int {name}() {{ return 0; }}")
+        fixes["missing_include"] = len(headers)
+        fixes["implicit_declaration"] = len(stubs)
+        fixes["prose"] = len(drop)
+        if not any(fixes.values()):
+            return code, fixes
+
+        lines = [line for i, line in enumerate(lines) if i not in drop]
+        # New lines go after the last top-of-file #include (or at the very top)
+        insert_at = 0
+        for i, line in enumerate(lines):
+            if re.match(r"^\s*#\s*include\b", line):
+                insert_at = i + 1
+            elif line.strip() and not line.lstrip().startswith(("#", "//", "/*", "*")):
+                break
+        added = [f"#include <{h}>" for h in headers] + stubs
+        lines[insert_at:insert_at] = added
+        return "\n".join(lines), fixes
+
+    def repair(self, program_path: str, options: str = "",
+               first_check: Optional[Tuple[bool, List[Tuple[int, str, str]]]] = None) -> Tuple[str, Optional[str]]:
+        """
+        Check and fix one program in place (the original is kept as <program>.c.orig when changed).
+        :param first_check: result of a check() already done on the unmodified program (saves one compile)
+        A program the host compiler cannot judge on the first check is left unchanged.
+        :return: ("clean" | "repaired" | "unchecked" | "rejected", last host compiler diagnostics if rejected)
+        """
+        path = Path(program_path)
+        original = code = path.read_text(encoding="utf-8", errors="replace")
+        applied: Dict[str, int] = {}
+        for attempt in range(self.max_attempts):
+            ok, diags = first_check if attempt == 0 and first_check is not None else self.check(str(path), options)
+            if ok or attempt == 0 and host_unsure(diags):
+                break
+            code, fixes = self.fix(code, diags)
+            if not any(fixes.values()):
+                break
+            for key, count in fixes.items():
+                applied[key] = applied.get(key, 0) + count
+            path.write_text(code, encoding="utf-8")
+        else:
+            ok, diags = self.check(str(path), options)
+
+        if ok:
+            status = "repaired" if code != original else "clean"
+        elif host_unsure(diags):
+            status = "unchecked"
+        else:
+            status = "rejected"
+        if code != original:
+            path.with_name(path.name + ".orig").write_text(original, encoding="utf-8")
+        with self._lock:
+            self.stats[status] += 1
+            for key, count in applied.items():
+                self.stats[key] += count
+        if status != "rejected":
+            return status, None
+        return status, format_errors(diags)
+
+    def run(self, program_paths: List[str], options: str = "") -> Tuple[List[str], List[Tuple[str, str]]]:
+        """
+        Repair a batch in parallel.
+        :return: (programs to compile with the instrumented GCC, [(rejected program, host diagnostics)])
+        """
+        with ThreadPoolExecutor(max_workers=self.max_workers) as pool:
+            results = list(pool.map(lambda p: self.repair(p, options), program_paths))
+        forward, rejected = split_results(program_paths, results)
+        repaired = sum(1 for status, _ in results if status == "repaired")
+        unchecked = sum(1 for status, _ in results if status == "unchecked")
+        print(f"  [Repair] {len(forward)}/{len(program_paths)} programs pass the host compiler "
+              f"({repaired} repaired, {unchecked} unchecked, {len(rejected)} rejected)")
+        return forward, rejected
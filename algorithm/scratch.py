@@ -0,0 +1,164 @@
+import fnmatch
+import os
+import shutil
+import tempfile
+import threading
+import time
+from pathlib import Path
+from typing import Dict, List, Optional, Sequence, Tuple
+
+
+def output_path(output_dir: str, source: str, suffix: str) -> Path:
+    """
+    Path of a compile output of source under output_dir, in a subdirectory named after the source's
+    directory: every batch names its programs iter_0001.., so outputs of different batches must not share
+    a directory.
+    """
+    src = Path(source)
+    directory = Path(output_dir) / src.parent.name
+    directory.mkdir(parents=True, exist_ok=True)
+    return directory / (src.stem + suffix)
+
+
+class ScratchWorkspace:
+    """
+    RAM-backed (tmpfs) scratch area for the high-churn files of a run: compile outputs, per-worker
+    GCOV_PREFIX trees, .gcov reports and a working copy of the live .gcda profiles.
+    Durable files are mirrored: copied in at start, and at every checkpoint the changed ones are first
+    snapshotted inside the scratch area (fast, consistent) and then written back to persistent storage by
+    a background thread, so the loop never waits on NFS/SSD I/O.
+    """
+    def __init__(self, root: str = "/dev/shm/gapsmith", keep: bool = False):
+        """
+        :param root: parent of the scratch directories, normally on a tmpfs such as /dev/shm; every workspace
+                     gets its own run_* directory in it, so concurrent runs and the leftovers of a crashed run
+                     (e.g. unfolded worker profiles) never mix
+        :param keep: leave the scratch directory in place on close() (default: removed after the final sync)
+        """
+        os.makedirs(root, exist_ok=True)
+        self.root = tempfile.mkdtemp(prefix="run_", dir=os.path.abspath(root))
+        self.keep = keep
+        self._mirrors: List[Tuple[str, str, Sequence[str]]] = []  # (scratch dir, persistent dir, synced patterns)
+        self._synced: Dict[str, Tuple[int, int]] = {}  # {scratch file: (mtime_ns, size) last written back}
+        self._sync_thread: Optional[threading.Thread] = None
+        self._checkpoints = 0
+        self.stats = {"checkpoints": 0, "files": 0, "bytes": 0, "sync_time": 0.0}
+
+    def path(self, name: str) -> str:
+        """Scratch-only directory (not synced), e.g. for executables or worker profile trees."""
+        path = os.path.join(self.root, name)
+        os.makedirs(path, exist_ok=True)
+        return path
+
+    @staticmethod
+    def _matches(name: str, patterns: Sequence[str]) -> bool:
+        return any(fnmatch.fnmatch(name, p) for p in patterns)
+
+    def mirror(self, persistent_dir: str, name: str, patterns: Sequence[str] = ("*",),
+               link_patterns: Sequence[str] = ()) -> str:
+        """
+        Mirror persistent_dir into the scratch area and sync it back at checkpoints.
+        :param patterns: files copied in and written back (fnmatch on the file name)
+        :param link_patterns: read-only files that are only symlinked (e.g. *.gcno next to the .gcda files)
+        :return: the scratch directory to use instead of persistent_dir
+        """
+        persistent_dir = os.path.abspath(persistent_dir)
+        scratch_dir = os.path.join(self.root, name)
+        os.makedirs(scratch_dir, exist_ok=True)
+        for dirpath, _, files in os.walk(persistent_dir):
+            target_dir = os.path.normpath(os.path.join(scratch_dir, os.path.relpath(dirpath, persistent_dir)))
+            for file in files:
+                src = os.path.join(dirpath, file)
+                dest = os.path.join(target_dir, file)
+                if self._matches(file, link_patterns):
+                    os.makedirs(target_dir, exist_ok=True)
+                    if not os.path.lexists(dest):
+                        os.symlink(src, dest)
+                elif self._matches(file, patterns):
+                    os.makedirs(target_dir, exist_ok=True)
+                    shutil.copy2(src, dest)
+                    st = os.stat(dest)
+                    self._synced[dest] = (st.st_mtime_ns, st.st_size)
+        self._mirrors.append((scratch_dir, persistent_dir, tuple(patterns)))
+        return scratch_dir
+
+    def mirror_profiles(self, source_dirs: List[str], name: str = "profiles") -> Tuple[str, List[str]]:
+        """
+        Working copy of the compiler's profile directories: .gcda files copied, .gcno files symlinked.
+        :return: (scratch root replacing the common root of source_dirs, scratch source_dirs in the same order)
+        """
+        root = os.path.commonpath([os.path.abspath(d) for d in source_dirs])
+        scratch_root = os.path.join(self.root, name)
+        for d in source_dirs:
+            rel = os.path.relpath(os.path.abspath(d), root)
+            self.mirror(d, os.path.join(name, rel) if rel != "." else name, patterns=("*.gcda",),
+                        link_patterns=("*.gcno",))
+        return scratch_root, [os.path.normpath(os.path.join(scratch_root, os.path.relpath(os.path.abspath(d), root)))
+                              for d in source_dirs]
+
+    def checkpoint(self, wait: bool = False) -> int:
+        """
+        Write the mirrored files changed since the last checkpoint back to persistent storage.
+        :param wait: block until they are written (default: return once they are snapshotted)
+        :return: number of files in this checkpoint
+        """
+        if self._sync_thread is not None:
+            self._sync_thread.join()  # never let two syncs of the same files overlap
+            self._sync_thread = None
+        self._checkpoints += 1
+        stage = os.path.join(self.root, ".checkpoint", str(self._checkpoints))
+        jobs: List[Tuple[str, str]] = []  # (snapshot, persistent path)
+        for scratch_dir, persistent_dir, patterns in self._mirrors:
+            for dirpath, _, files in os.walk(scratch_dir):
+                if dirpath.startswith(os.path.join(self.root, ".checkpoint")):
+                    continue
+                for file in files:
+                    src = os.path.join(dirpath, file)
+                    if os.path.islink(src) or not self._matches(file, patterns):
+                        continue
+                    snapshot = os.path.join(stage, str(len(jobs)))
+                    try:
+                        st = os.stat(src)
+                        if self._synced.get(src) == (st.st_mtime_ns, st.st_size):
+                            continue
+                        os.makedirs(stage, exist_ok=True)
+                        shutil.copy2(src, snapshot)
+                    except FileNotFoundError:
+                        continue  # a transient file (e.g. of a gcov worker) vanished
+                    rel = os.path.relpath(src, scratch_dir)
+                    self._synced[src] = (st.st_mtime_ns, st.st_size)
+                    jobs.append((snapshot, os.path.join(persistent_dir, rel)))
+        if not jobs:
+            return 0
+        self._sync_thread = threading.Thread(target=self._write_back, args=(stage, jobs), daemon=True)
+        self._sync_thread.start()
+        if wait:
+            self._sync_thread.join()
+            self._sync_thread = None
+        return len(jobs)
+
+    def _write_back(self, stage: str, jobs: List[Tuple[str, str]]):
+        start = time.time()
+        written = 0
+        for snapshot, dest in jobs:
+            try:
+                os.makedirs(os.path.dirname(dest), exist_ok=True)
+                tmp = f"{dest}.gapsmith_sync"
+                shutil.copy2(snapshot, tmp)
+                os.replace(tmp, dest)
+                written += os.path.getsize(dest)
+            except OSError as e:
+                print(f"[Scratch] Sync failed for {dest}: {e}")
+        shutil.rmtree(stage, ignore_errors=True)
+        self.stats["checkpoints"] += 1
+        self.stats["files"] += len(jobs)
+        self.stats["bytes"] += written
+        self.stats["sync_time"] += time.time() - start
+        print(f"[Scratch] Checkpoint synced {len(jobs)} files ({written / 1048576:.1f} MiB) "
+              f"in {time.time() - start:.2f}s")
+
+    def close(self):
+        """Final synchronous checkpoint; removes the scratch area unless keep is set."""
+        self.checkpoint(wait=True)
+        if not self.keep:
+            shutil.rmtree(self.root, ignore_errors=True)
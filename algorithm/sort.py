@@ -8,11 +8,14 @@ class GapSmithSelector:
     """
     GapSmith target file selector
     """
-    def __init__(self, report_folder: str):
+    def __init__(self, report_folder: str, file_weights: Optional[Dict[str, float]] = None):
         """
         :param report_folder: coverage report txt files directory
+        :param file_weights: optional factor on each file's score, keyed by file basename
+                             (e.g. BlockIndex.frontier_weights(); unlisted files keep 1.0, 0 excludes a file)
         """
         self.report_folder = report_folder
+        self.file_weights = file_weights or {}
         self.pattern = re.compile(r"^\s*(?P<file>.*?):\s+(?P<percent>[\d.]+)%\s+of\s+(?P<lines>\d+)\s+lines")
         self.targets: List[Dict] = []
         self.t_param = 10 
@@ -40,6 +43,7 @@ class GapSmithSelector:
                                 'filename': filename,
                                 'Lf': lines_count,
                                 'Cf': coverage_ratio,
+                                'Df': 1.0,
                                 'Sf': 0.0,
                                 'Wf': 0.0,
                                 'Pf': 0.0
@@ -47,17 +51,21 @@ class GapSmithSelector:
 
     def calculate_metrics(self):
         """
-        1. Sf = Lf * (1 - Cf)^2 
+        1. Sf = Lf * (1 - Cf)^2 * Df (Df = file weight, 1.0 by default; files with Df = 0 are dropped)
         2. Wf = Sf / Sum(Sf)
         3. Pf = 1 - (1 - Wf)^t
         """
+        for target in self.targets:
+            target['Df'] = self.file_weights.get(os.path.basename(target['filename'].replace("\\", "/")), 1.0)
+        self.targets = [t for t in self.targets if t['Df'] > 0]
         if not self.targets:
             return
         total_score_S = 0.0
         for target in self.targets:
             lf = target['Lf']
             cf = target['Cf']
-            sf = lf * math.pow((1.0 - cf), 2)
+            df = target['Df']
+            sf = lf * math.pow((1.0 - cf), 2) * df
             target['Sf'] = sf
             total_score_S += sf
         if total_score_S == 0:
@@ -0,0 +1,332 @@
+import bisect
+import hashlib
+import json
+import os
+import re
+import threading
+from typing import Dict, List, Optional, Tuple
+
+# Comments, string/char literals and preprocessor lines are blanked (newlines kept) before scanning
+_NOISE = re.compile(r'//[^\n]*|/\*.*?\*/|"(?:\\.|[^"\\\n])*"|\'(?:\\.|[^\'\\\n])*\'|^[ \t]*#(?:\\\n|[^\n])*',
+                    re.DOTALL | re.MULTILINE)
+_TOKEN = re.compile(r"[{}();]|\bcase\b|\bdefault\s*:(?!:)")
+_CONTROL = re.compile(r"(else\s+if|if|for|while|switch|else|do)\b")
+_FUNCTION_NAME = re.compile(r"([A-Za-z_][\w:~]*)\s*\(")
+_NOT_FUNCTIONS = {"if", "while", "for", "switch", "return", "sizeof", "catch"}
+_CALL = re.compile(r"([A-Za-z_]\w*)\s*\(")
+_NOT_CALLS = _NOT_FUNCTIONS | {"else", "do", "case", "defined", "alignof", "__alignof__", "typeof", "__typeof__",
+                               "decltype", "__builtin_expect", "gcc_assert", "gcc_checking_assert",
+                               "gcc_unreachable", "static_cast", "const_cast", "reinterpret_cast",
+                               "dynamic_cast"}
+_FORMAT = 4  # version of the cached structures
+_MAX_HEADER_LINES = 4  # lines of one condition/signature shown at most
+
+
+def _blank(m: "re.Match") -> str:
+    return re.sub(r"[^\n]", " ", m.group())
+
+
+def _paren_end(text: str, start: int) -> int:
+    """Index after the parenthesized group starting at text[start] == '(' (len(text) if unbalanced)."""
+    depth = 0
+    for i in range(start, len(text)):
+        if text[i] == "(":
+            depth += 1
+        elif text[i] == ")":
+            depth -= 1
+            if depth == 0:
+                return i + 1
+    return len(text)
+
+
+class FileStructure:
+    """
+    Functions and control regions of one source file, as line intervals (1-based):
+      functions: [name, head_start, head_end, end, calls] where calls are the names called in the body
+      regions: [kind, header_start, header_end, body_start, body_end, chain, labels] where kind is
+               if/else if/else/for/while/switch/do, chain lists the [start, end] headers of the preceding
+               if/else if branches (for else branches) and labels the case/default lines (for switches)
+    """
+    def __init__(self, functions: List[list], regions: List[list]):
+        self.functions = functions
+        self.regions = regions
+
+    @classmethod
+    def scan(cls, text: str) -> "FileStructure":
+        clean = _NOISE.sub(_blank, text)
+        newlines = [i for i, c in enumerate(clean) if c == "\n"]
+
+        def line_of(offset: int) -> int:
+            return bisect.bisect_left(newlines, offset) + 1
+
+        functions: List[list] = []
+        regions: List[list] = []
+        stack: List[dict] = []  # open braces: {"kind", "region"/"function", ...}
+        siblings: Dict[int, List[list]] = {}  # {depth: headers of the if/else-if chain just closed there}
+        # {depth: braceless regions (loops, outer ifs) around the innermost if of that chain, which a following
+        # else still belongs to}
+        enclosing: Dict[int, List[list]] = {}
+        last = 0  # offset after the last statement delimiter
+        paren_depth = 0
+        in_function = 0
+
+        def statement_start(offset: int) -> int:
+            while offset < len(clean) and clean[offset].isspace():
+                offset += 1
+            return offset
+
+        def braceless(stmt_from: int, stmt_to: int):
+            """
+            Record `if (c) stmt;`-style regions in clean[stmt_from:stmt_to] (nested prefixes too); an else
+            statement also extends the regions enclosing the if it belongs to (`for (...) if (c) x; else y;`).
+            :return: (the if/else-if chain a following else continues, the regions it extends), or None if the
+                     statement is not such a branch
+            """
+            stmt_from = pos = statement_start(stmt_from)
+            continued = None
+            outer: List[list] = []  # regions of this statement, then those around the innermost if
+            inherited: List[list] = []
+            while pos < stmt_to:
+                m = _CONTROL.match(clean, pos, stmt_to)
+                if not m or m.group(1) == "do":
+                    break
+                kind = re.sub(r"\s+", " ", m.group(1))
+                header_end = m.end()
+                if kind != "else":
+                    paren = clean.find("(", m.end(), stmt_to)
+                    if paren == -1:
+                        break
+                    header_end = _paren_end(clean, paren)
+                if header_end >= stmt_to:
+                    break
+                body = statement_start(header_end)
+                chain = []
+                if kind.startswith("else") and pos == stmt_from:
+                    chain = siblings.get(len(stack), [])
+                    inherited = enclosing.get(len(stack), [])
+                region = [kind, line_of(pos), line_of(header_end - 1), line_of(body), line_of(stmt_to), list(chain), []]
+                if kind in ("if", "else if"):  # a following else binds to the innermost one
+                    continued = (chain + [[line_of(pos), line_of(header_end - 1)]], list(outer))
+                regions.append(region)
+                outer.append(region)
+                pos = body
+            for region in inherited:
+                region[4] = line_of(stmt_to)
+            if continued is not None:
+                continued = (continued[0], inherited + continued[1])
+            return continued
+
+        for m in _TOKEN.finditer(clean):
+            tok = m.group()
+            if tok == "(":
+                paren_depth += 1
+                continue
+            if tok == ")":
+                paren_depth = max(0, paren_depth - 1)
+                continue
+            if paren_depth and tok != "{" and tok != "}":
+                continue  # ';' inside a for header
+            if tok == "{":
+                start = statement_start(last)
+                header = clean[start:m.start()].strip()
+                header_end = line_of(start + len(header) - 1) if header else line_of(m.start())
+                frame = {"kind": "block", "start": start, "depth": len(stack), "region": None, "function": None}
+                control = _CONTROL.match(header) if in_function else None
+                if control:
+                    kind = re.sub(r"\s+", " ", control.group(1))
+                    chain = []
+                    extends = []
+                    if kind.startswith("else"):
+                        chain = siblings.get(len(stack), [])
+                        extends = enclosing.get(len(stack), [])
+                    region = [kind, line_of(start), header_end, line_of(m.start()), 0, list(chain), []]
+                    regions.append(region)
+                    frame.update(kind=kind, region=region, extends=extends)
+                elif not in_function and not paren_depth:
+                    fm = None
+                    for fm in _FUNCTION_NAME.finditer(header):
+                        break
+                    if (fm and fm.group(1) not in _NOT_FUNCTIONS and "=" not in header[:fm.start()]
+                            and not re.match(r"^(struct|class|union|enum|namespace|extern\s*$)", header)):
+                        function = [fm.group(1), line_of(start), header_end, 0, m.end()]
+                        functions.append(function)
+                        frame.update(kind="function", function=function)
+                        in_function += 1
+                stack.append(frame)
+                last = m.end()
+            elif tok == "}":
+                if stack:
+                    frame = stack.pop()
+                    end_line = line_of(m.start())
+                    if frame["region"] is not None:
+                        frame["region"][4] = end_line
+                        for region in frame.get("extends", []):
+                            region[4] = end_line
+                        if frame["kind"] in ("if", "else if"):
+                            own = [frame["region"][1], frame["region"][2]]
+                            siblings[len(stack)] = frame["region"][5] + [own]
+                            enclosing[len(stack)] = frame.get("extends", [])
+                        else:
+                            siblings.pop(len(stack), None)
+                            enclosing.pop(len(stack), None)
+                    if frame["function"] is not None:
+                        function = frame["function"]
+                        function[3] = end_line
+                        body = clean[function[4]:m.start()]
+                        function[4] = sorted({c for c in _CALL.findall(body) if c not in _NOT_CALLS})
+                        in_function -= 1
+                last = m.end()
+            elif tok == ";":
+                if in_function:
+                    continued = braceless(last, m.start())
+                    if continued is not None:
+                        siblings[len(stack)], enclosing[len(stack)] = continued
+                    else:
+                        siblings.pop(len(stack), None)
+                        enclosing.pop(len(stack), None)
+                last = m.end()
+            else:  # case / default label
+                for frame in reversed(stack):
+                    if frame["kind"] == "switch":
+                        frame["region"][6].append(line_of(m.start()))
+                        break
+                if tok.startswith("default"):
+                    last = m.end()
+                else:
+                    colon = clean.find(":", m.end())
+                    while colon != -1 and clean.startswith("::", colon):
+                        colon = clean.find(":", colon + 2)
+                    last = colon + 1 if colon != -1 else m.end()
+        return cls([f for f in functions if f[3]], [r for r in regions if r[4]])
+
+    def function_at(self, start: int, end: int) -> Optional[list]:
+        """Innermost function whose definition contains lines start..end, or None."""
+        enclosing = [f for f in self.functions if f[1] <= start and end <= f[3]]
+        return max(enclosing, key=lambda f: f[1]) if enclosing else None
+
+    def guards(self, start: int, end: int) -> List[list]:
+        """Regions whose body contains lines start..end (within the function at start), outermost first."""
+        function = self.function_at(start, start)
+        if function is None:
+            return []
+        return sorted((r for r in self.regions
+                       if function[1] <= r[1] < start and r[3] <= start and end <= r[4]),
+                      key=lambda r: (r[1], -r[4]))
+
+    def context_lines(self, start: int, end: int) -> Optional[List[int]]:
+        """
+        Lines that frame the block start..end: the signature of the innermost enclosing function, then the
+        headers of the enclosing conditions/loops (with the preceding branches of an else chain and the
+        case label in effect), outermost first. None if the block is not inside a function.
+        """
+        function = self.function_at(start, end)
+        if function is None:
+            return None
+        lines: List[int] = list(range(function[1], min(function[2], function[1] + _MAX_HEADER_LINES - 1) + 1))
+        for kind, h_start, h_end, _, _, chain, labels in self.guards(start, end):
+            for c_start, c_end in chain:
+                lines.extend(range(c_start, min(c_end, c_start + _MAX_HEADER_LINES - 1) + 1))
+            lines.extend(range(h_start, min(h_end, h_start + _MAX_HEADER_LINES - 1) + 1))
+            if kind == "switch":
+                label = [line for line in labels if line <= start]
+                if label:
+                    lines.append(label[-1])
+        return sorted({line for line in lines if not start <= line <= end})
+
+    def to_json(self) -> Dict:
+        return {"format": _FORMAT, "functions": self.functions, "regions": self.regions}
+
+
+class SourceIndex:
+    """
+    Structure (functions, conditions, switch cases) of the compiler's source files, scanned once per file
+    version with a lightweight brace/keyword lexer and cached in memory and under cache_dir.
+    Used to give an uncovered block the context that decides whether it runs instead of a fixed window of
+    nearby covered lines.
+    """
+    def __init__(self, cache_dir: str, source_roots: Optional[List[str]] = None):
+        """
+        :param cache_dir: directory of the per-file JSON structures
+        :param source_roots: directories searched for a source given by a relative path or basename
+                             (e.g. the target_dirs of GcovRunner)
+        """
+        self.cache_dir = cache_dir
+        self.source_roots = source_roots or []
+        os.makedirs(cache_dir, exist_ok=True)
+        self._structures: Dict[str, Tuple[Tuple[int, int], FileStructure]] = {}
+        self._by_name: Optional[Dict[str, List[str]]] = None
+        self._lock = threading.Lock()
+        self.stats = {"scanned": 0, "cached": 0, "unresolved": 0}
+
+    def _names(self) -> Dict[str, List[str]]:
+        """{basename: paths} of the files under source_roots (walked once)."""
+        with self._lock:
+            if self._by_name is None:
+                self._by_name = {}
+                for root in self.source_roots:
+                    for dirpath, _, files in os.walk(root):
+                        for file in files:
+                            self._by_name.setdefault(file, []).append(os.path.join(dirpath, file))
+            return self._by_name
+
+    def sources(self, extensions=(".c", ".cc", ".cpp")) -> List[str]:
+        """Source files (by extension) under source_roots."""
+        return sorted(path for paths in self._names().values() for path in paths if path.endswith(extensions))
+
+    def resolve(self, source: str) -> Optional[str]:
+        """Path of source: as given if it exists, else the file under source_roots with the longest matching suffix."""
+        if source and os.path.isfile(source):
+            return os.path.abspath(source)
+        candidates = self._names().get(os.path.basename(source), [])
+        if not candidates:
+            return None
+        parts = source.replace("\\", "/").split("/")
+
+        def common_suffix(path: str) -> int:
+            other = path.replace("\\", "/").split("/")
+            n = 0
+            while n < min(len(parts), len(other)) and parts[-1 - n] == other[-1 - n]:
+                n += 1
+            return n
+        return max(candidates, key=common_suffix)
+
+    def structure(self, source: str) -> Optional[FileStructure]:
+        """Structure of source (see resolve), or None if it cannot be found or read."""
+        path = self.resolve(source)
+        if path is None:
+            self.stats["unresolved"] += 1
+            return None
+        try:
+            st = os.stat(path)
+        except OSError:
+            return None
+        version = (st.st_mtime_ns, st.st_size)
+        with self._lock:
+            cached = self._structures.get(path)
+        if cached is not None and cached[0] == version:
+            return cached[1]
+
+        cache_file = os.path.join(self.cache_dir, hashlib.sha1(path.encode()).hexdigest()[:20] + ".json")
+        structure = None
+        try:
+            with open(cache_file, encoding="utf-8") as f:
+                data = json.load(f)
+            if (data.get("format") == _FORMAT and data.get("path") == path
+                    and tuple(data.get("version", ())) == version):
+                structure = FileStructure(data["functions"], data["regions"])
+                self.stats["cached"] += 1
+        except (OSError, ValueError, KeyError):
+            structure = None
+        if structure is None:
+            try:
+                with open(path, encoding="utf-8", errors="ignore") as f:
+                    structure = FileStructure.scan(f.read())
+            except OSError:
+                return None
+            self.stats["scanned"] += 1
+            with open(cache_file + ".tmp", "w", encoding="utf-8") as f:
+                json.dump({"path": path, "version": list(version), **structure.to_json()}, f)
+            os.replace(cache_file + ".tmp", cache_file)
+        with self._lock:
+            self._structures[path] = (version, structure)
+        return structure
@@ -0,0 +1,97 @@
+import os
+import re
+import shlex
+from typing import List, Optional
+
+# Compilation stages in pipeline order; compiling up to a stage runs every earlier one.
+# "preprocess" writes a .i file next to the program (see option_matrix.py); no target file maps to it.
+STAGES = ["preprocess", "parse", "gimple", "rtl", "assemble", "link", "lto"]
+
+# (pattern on the '/'-separated source path, stage); the first match wins
+_FILE_RULES = [
+    # Front-end parts that only run when lowering to GENERIC/GIMPLE
+    (r"(^|/)(c-family|c|cp|objc|objcp)/[^/]*gimplify[^/]*$", "gimple"),
+    (r"(^|/)c-family/c-(ubsan|omp)\.cc$", "gimple"),
+    (r"(^|/)cp/(optimize|cp-ubsan|cp-gimplify)\.cc$", "gimple"),
+    (r"(^|/)fortran/trans[^/]*$", "gimple"),
+    # Front ends, the preprocessor and option/diagnostic handling run under -fsyntax-only
+    (r"(^|/)(c-family|c|cp|objc|objcp|fortran|ada|d|go|m2|rust|jit)/", "parse"),
+    (r"(^|/)(libcpp|libiberty)/", "parse"),
+    (r"(^|/)gcc/(toplev|opts|opts-common|opts-global|diagnostic[^/]*|input|pretty-print|langhooks|"
+     r"stringpool|attribs)\.cc$", "parse"),
+    # LTO streaming and the LTO front end need -flto and a link step (lto1 runs from the linker plugin)
+    (r"(^|/)lto/", "lto"),
+    (r"(^|/)gcc/lto-[^/]*\.cc$", "lto"),
+    # The driver and link-time tools
+    (r"(^|/)gcc/(gcc|gcc-main|collect2|collect2-aix|collect-utils|lto-wrapper)\.cc$", "link"),
+    # Middle end
+    (r"(^|/)gcc/(tree-|gimple|ipa-|omp-|cgraph|gimplify|passes|tree\.cc|fold-const|stor-layout|"
+     r"symtab|varpool|cfgexpand|trans-mem|asan|ubsan|tsan)", "gimple"),
+    # Everything else in the compiler proper: RTL passes, back ends, generated insn-* files
+    (r"(^|/)gcc/", "rtl"),
+]
+
+# Options that only take effect in a later stage
+_OPTION_RULES = [
+    (r"^-flto", "lto"),
+    (r"^(-Wl,|-l|-L|-static|-shared|-pie$|-no-pie$|-fuse-ld=|-nostdlib|-nostartfiles|-rdynamic)", "link"),
+    (r"^(-Wa,|-save-temps)", "assemble"),
+]
+
+# Options that already choose where the driver stops; stage-aware compilation leaves them alone
+_STOP_OPTIONS = {"-E", "-S", "-c", "-fsyntax-only"}
+
+
+def stage_for_file(target_file: str) -> str:
+    """
+    Earliest compilation stage that exercises the given compiler source file.
+    Unknown files (outside the compiler proper) need the full pipeline: "link".
+    """
+    path = target_file.replace("\\", "/")
+    for pattern, stage in _FILE_RULES:
+        if re.search(pattern, path):
+            return stage
+    return "link"
+
+
+def stage_for_options(compile_options: Optional[str]) -> Optional[str]:
+    """Latest stage any of the options needs to take effect, or None."""
+    needed = None
+    for opt in shlex.split(compile_options or ""):
+        for pattern, stage in _OPTION_RULES:
+            if re.search(pattern, opt) and (needed is None or STAGES.index(stage) > STAGES.index(needed)):
+                needed = stage
+    return needed
+
+
+def compile_stage(target_file: str, compile_options: Optional[str]) -> Optional[str]:
+    """
+    Stage at which compiling for target_file can stop: the file's stage, raised to what the options need.
+    :return: stage name, or None when the options already select an output kind (-E/-S/-c/-fsyntax-only)
+    """
+    if _STOP_OPTIONS.intersection(shlex.split(compile_options or "")):
+        return None
+    stage = stage_for_file(target_file)
+    needed = stage_for_options(compile_options)
+    if needed is not None and STAGES.index(needed) > STAGES.index(stage):
+        stage = needed
+    return stage
+
+
+def stage_output_args(stage: Optional[str], output_path: str, compile_options: Optional[str] = None) -> List[str]:
+    """
+    Driver arguments that stop at stage (appended after the source file).
+    :param stage: one of STAGES, or None for a linked executable
+    :param output_path: executable path used by the link and lto stages (preprocess: its .i sibling)
+    """
+    if stage == "preprocess":
+        return ["-E", "-o", os.path.splitext(output_path)[0] + ".i"]
+    if stage == "parse":
+        return ["-fsyntax-only"]
+    if stage in ("gimple", "rtl"):
+        return ["-S", "-o", os.devnull]
+    if stage == "assemble":
+        return ["-c", "-o", os.devnull]
+    if stage == "lto" and not any(o.startswith("-flto") for o in shlex.split(compile_options or "")):
+        return ["-flto", "-o", output_path]
+    return ["-o", output_path]
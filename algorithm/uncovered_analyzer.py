@@ -1,24 +1,48 @@
 import os
 import re
+from array import array
+from typing import Optional
+
+# Count column encoding: execution counts are stored as is, these mark the other gcov count texts
+NEUTRAL = -1  # "-"
+UNCOVERED = -2  # "#####"
+OTHER = -3  # anything else ("=====", "12*"), kept verbatim
+# Line classification
+KIND_OTHER, KIND_COVERED, KIND_UNCOVERED, KIND_NEUTRAL = 0, 1, 2, 3
 
 
 class UncoveredBlockAnalyzer:
-    def __init__(self, gcov_file: str, context_limit: int = 20):
+    def __init__(self, gcov_file: str, context_limit: int = 20, source_index=None):
         """
         Uncovered block analyzer
         Function:
         - Parse .gcov file
         - Extract consecutive uncovered blocks (#####)
-        - Extract at most context_limit lines of "covered code" before and after each uncovered block as context
+        - Extract at most context_limit lines of "covered code" before and after each uncovered block as context,
+          or, with a source_index, the enclosing function's signature and the conditions guarding the block
         :param gcov_file: .gcov file path
         :param context_limit: context limit
+        :param source_index: SourceIndex of the compiler sources (None = covered-line window only)
         """
         self.gcov_file = gcov_file
         self.context_limit = context_limit
+        self.source_index = source_index
+        self.source_path = ""  # source file of the report ("Source:" header or parse_counts)
+        self._structure = None
+        self._line_index = None
         self.line_pattern = re.compile(
             r'^\s*(?P<count>[#\-\d]+):\s*(?P<line_num>\d+):(?P<code>.*)$'
         )
-        self.entries = []  # [{"count","line_num","code"}...]
+        # Columns, one element per line: line number, count (see NEUTRAL/UNCOVERED/OTHER), code, classification
+        self.line_nums = array('i')
+        self.count_values = array('q')
+        self.codes = []
+        self.kinds = bytearray()
+        self._count_text = {}  # {entry index: count text} for OTHER counts
+        self._entry_cache = []  # [dict or None] per entry, for the lines handed out in blocks
+        self._entries = None
+        self.covered_rank = array('i', [0])
+        self.covered_pos = array('i')
         self.blocks = []
 
     def _is_pure_comment(self, code: str) -> bool:
@@ -60,6 +84,63 @@ class UncoveredBlockAnalyzer:
         """
         return count == '-'
 
+    def _reset(self):
+        self.line_nums = array('i')
+        self.count_values = array('q')
+        self.codes = []
+        self.kinds = bytearray()
+        self._count_text = {}
+        self._entries = None
+        self._structure = None
+        self._line_index = None
+        self.blocks.clear()
+
+    def _append(self, count: str, line_num: int, code: str):
+        """Append one line to the columns, classifying it once."""
+        idx = len(self.codes)
+        if count == '-':
+            value, kind = NEUTRAL, KIND_NEUTRAL
+        elif count == '#####':
+            value = UNCOVERED
+            kind = KIND_UNCOVERED if self._is_code_line(code) else KIND_OTHER
+        elif count.isdigit():
+            value = int(count)
+            kind = KIND_COVERED if self._is_code_line(code) else KIND_OTHER
+        else:
+            # e.g. "=====" or "12*": kept verbatim, neither covered nor uncovered
+            value, kind = OTHER, KIND_OTHER
+            self._count_text[idx] = count
+        self.line_nums.append(line_num)
+        self.count_values.append(value)
+        self.codes.append(code)
+        self.kinds.append(kind)
+
+    def count_text(self, idx: int) -> str:
+        """gcov count column of entry idx ("-", "#####" or the execution count)."""
+        value = self.count_values[idx]
+        if value == NEUTRAL:
+            return '-'
+        if value == UNCOVERED:
+            return '#####'
+        if value == OTHER:
+            return self._count_text[idx]
+        return str(value)
+
+    def entry(self, idx: int) -> dict:
+        """{"count","line_num","code"} dict of entry idx, created once and shared by all blocks using it."""
+        e = self._entry_cache[idx]
+        if e is None:
+            e = self._entry_cache[idx] = {"count": self.count_text(idx), "line_num": self.line_nums[idx],
+                                          "code": self.codes[idx]}
+        return e
+
+    @property
+    def entries(self):
+        """All lines as {"count","line_num","code"} dicts (built on demand; the analyzer itself uses the columns)."""
+        if self._entries is None:
+            self._entries = [self.entry(i) for i in range(len(self.codes))]
+        return self._entries
+
     def parse(self):
         """
         Parse gcov file, and build uncovered blocks
@@ -67,73 +148,108 @@ class UncoveredBlockAnalyzer:
 
         if not os.path.isfile(self.gcov_file):
             raise FileNotFoundError(f"file not found: {self.gcov_file}")
-        self.entries.clear()
-        self.blocks.clear()
+        self._reset()
+        match = self.line_pattern.match
         with open(self.gcov_file, 'r', encoding='utf-8', errors='ignore') as f:
             for raw in f:
-                m = self.line_pattern.match(raw)
+                m = match(raw)
                 if not m:
                     continue
+                self._append(m.group("count").strip(), int(m.group("line_num")), m.group("code"))
+        for idx in range(len(self.codes)):
+            if self.line_nums[idx] != 0:
+                break
+            if self.codes[idx].startswith("Source:"):
+                # Relative to the directory gcov ran in (usually where the report is)
+                source = self.codes[idx][len("Source:"):].strip()
+                local = os.path.join(os.path.dirname(self.gcov_file), source)
+                self.source_path = local if os.path.isfile(local) else source
+        self._build_blocks()
+
+    def parse_counts(self, line_counts, source_path: str):
+        """
+        Build uncovered blocks from in-memory per-line counts (json/native collection)
+        instead of a .gcov file
+        :param line_counts: per-line execution counts indexed by line number, -1 = not executable
+        :param source_path: source file path, used for the code text of each line
+        """
+        self._reset()
+        self.source_path = source_path
+        try:
+            with open(source_path, 'r', encoding='utf-8', errors='ignore') as f:
+                code_lines = f.read().split('\n')
+            if code_lines and code_lines[-1] == '':
+                code_lines.pop()
+        except OSError:
+            code_lines = []
+        for line_num in range(1, max(len(code_lines), len(line_counts) - 1) + 1):
+            c = line_counts[line_num] if line_num < len(line_counts) else -1
+            self._append('-' if c < 0 else ('#####' if c == 0 else str(c)), line_num,
+                         code_lines[line_num - 1] if line_num <= len(code_lines) else "")
+        self._build_blocks()
+
+    def _build_blocks(self):
+        """
+        Build uncovered blocks from the columns: a block starts at an uncovered executable line and extends
+        over uncovered and neutral lines. The covered-line prefix index is built in the same pass.
+        """
+        kinds = self.kinds
+        n = len(kinds)
+        self._entry_cache = [None] * n
+        if self.source_index is not None and self.source_path:
+            self._structure = self.source_index.structure(self.source_path)
+            if self._structure is not None:
+                self._line_index = {line: idx for idx, line in enumerate(self.line_nums) if line > 0}
+        # covered_rank[i] = number of covered lines before entry i; covered_pos = their entry indexes
+        self.covered_rank = array('i', [0]) * (n + 1)
+        self.covered_pos = array('i')
+        rank = 0
+        for idx in range(n):
+            if kinds[idx] == KIND_COVERED:
+                self.covered_pos.append(idx)
+                rank += 1
+            self.covered_rank[idx + 1] = rank
 
-                self.entries.append({
-                    "count": m.group("count").strip(),
-                    "line_num": int(m.group("line_num")),
-                    "code": m.group("code")
-                })
-
-        in_block = False
-        start_idx = None
-        cur_block = []
-        uncovered_exec_count = 0  
-        for idx, e in enumerate(self.entries):
-            c = e["count"]
-            code = e["code"]
-            if self._is_uncovered_exec(c, code):
-                if not in_block:
-                    in_block = True
-                    start_idx = idx
-                    cur_block = []
-                    uncovered_exec_count = 0
-
-                cur_block.append(e)
-                uncovered_exec_count += 1
-                continue
-            if in_block and self._is_neutral(c):
-                cur_block.append(e)
-                continue
-            if in_block:
-                end_idx = idx - 1
-                self._save_block(start_idx, end_idx, cur_block, uncovered_exec_count)
-                in_block = False
-                start_idx = None
-                cur_block = []
-                uncovered_exec_count = 0
-        if in_block and start_idx is not None and cur_block:
-            self._save_block(start_idx, len(self.entries) - 1, cur_block, uncovered_exec_count)
+        idx = kinds.find(KIND_UNCOVERED)
+        while idx != -1:
+            end = idx + 1
+            while end < n and kinds[end] in (KIND_UNCOVERED, KIND_NEUTRAL):
+                end += 1
+            self._save_block(idx, end - 1, kinds.count(KIND_UNCOVERED, idx, end))
+            idx = kinds.find(KIND_UNCOVERED, end)
+        self._entry_cache = [None] * n  # the blocks keep the dicts they use
+
+    def _structural_context(self, start_idx: int, end_idx: int) -> Optional[list]:
+        """
+        Signature of the function enclosing the block and the headers of the conditions, loops and switch
+        cases guarding it, whatever their coverage; None if the source structure does not place the block
+        """
+        lines = self._structure.context_lines(self.line_nums[start_idx], self.line_nums[end_idx])
+        if not lines:
+            return None
+        positions = [self._line_index[line] for line in lines if line in self._line_index]
+        if len(positions) > 2 * self.context_limit:
+            # Deep nesting: the signature and the innermost guards
+            head = self.context_limit // 2
+            positions = positions[:head] + positions[head - 2 * self.context_limit:]
+        return [self.entry(i) for i in positions]
 
     def _collect_context(self, start_idx: int, end_idx: int):
         """
         Collect at most context_limit lines of "covered code" before and after each uncovered block
+        (slices of the covered-line index, no scanning); the structural context instead when the
+        block's enclosing function is known
         """
-        before = []
-        i = start_idx - 1
-        while i >= 0 and len(before) < self.context_limit:
-            e = self.entries[i]
-            if self._is_covered(e["count"], e["code"]):
-                before.append(e)
-            i -= 1
-        before.reverse()
-        after = []
-        i = end_idx + 1
-        while i < len(self.entries) and len(after) < self.context_limit:
-            e = self.entries[i]
-            if self._is_covered(e["count"], e["code"]):
-                after.append(e)
-            i += 1
-
-        return before + after
-
-    def _save_block(self, start_idx: int, end_idx: int, uncovered_block, uncovered_exec_count: int):
+        if self._structure is not None:
+            context = self._structural_context(start_idx, end_idx)
+            if context is not None:
+                return context
+        k = self.covered_rank[start_idx]
+        j = self.covered_rank[end_idx + 1]
+        positions = self.covered_pos[max(0, k - self.context_limit):k] + self.covered_pos[j:j + self.context_limit]
+        return [self.entry(i) for i in positions]
+
+    def _save_block(self, start_idx: int, end_idx: int, uncovered_exec_count: int):
         """
         Save block:
         - block_size only counts ##### executable lines
@@ -146,7 +262,7 @@ class UncoveredBlockAnalyzer:
 
         self.blocks.append({
             "covered_context": covered_context,
-            "uncovered_block": uncovered_block,
+            "uncovered_block": [self.entry(i) for i in range(start_idx, end_idx + 1)],
             "block_size": uncovered_exec_count
         })
 
@@ -1,12 +1,19 @@
 import time, re, os, random
 import shlex
-import subprocess
+import functools
 import json
 from pathlib import Path
 from datetime import datetime, timedelta
-from typing import List, Dict, Tuple, Optional, Any
+import linecache
+from array import array
+from typing import List, Dict, Set, Tuple, Optional, Any
 from collections import OrderedDict
 
+from algorithm.coverage_snapshot import CoverageSnapshot, iter_bits
+from algorithm.stage_map import compile_stage, stage_output_args
+from algorithm.compile_profile import CompileProfiler, run_profiled, split_reports
+from algorithm.scratch import output_path
+
 def clean_compile_options(text: str) -> str:
     """
     Clean compile options from a text string.
@@ -106,13 +113,18 @@ def compile_program(
     compile_options: Optional[str] = None,
     gcc_path: Optional[str] = None,
     timeout_sec: int = 60,
+    env: Optional[Dict[str, str]] = None,
+    stage: Optional[str] = None,
+    profiler: Optional[CompileProfiler] = None,
+    output_dir: Optional[str] = None,
 ) -> Tuple[bool, Optional[str]]:
     """
     Compile a single source program and generate an executable binary.
 
     Functionality:
     - Compiles the source file specified by program_path
-    - Produces an executable with the same base name and ".out" extension
+    - Produces an executable with the same base name and ".out" extension,
+      or stops early at the given compilation stage (e.g. -fsyntax-only for front-end targets)
     - Supports custom compilation options (e.g., "-O2 -fsanitize=address -fopenmp")
     - Captures and returns compilation errors (stderr)
 
@@ -122,6 +134,11 @@ def compile_program(
                             If None, "-O3" is used by default.
     :param gcc_path: Path to the compiler executable. If None, a default path is used.
     :param timeout_sec: Compilation timeout in seconds (prevents hanging processes)
+    :param env: Environment of the compiler process (e.g., a per-worker GCOV_PREFIX). If None, inherited.
+    :param stage: Last compilation stage to run (see algorithm/stage_map.py). If None, a linked executable is built.
+    :param profiler: Records time, peak memory and (-ftime-report) pass breakdown of the compile. If None, not recorded.
+    :param output_dir: Directory of the executable (e.g. a tmpfs scratch directory). If None, next to the source.
+                       Preprocessed .i files always stay next to the source.
 
     Returns:
     :return: (success_flag, error_message)
@@ -137,32 +154,34 @@ def compile_program(
         gcc_path = "gcc-build/bin/gcc"
 
     out = src.with_suffix(".out")
+    if output_dir is not None and stage != "preprocess":
+        out = output_path(output_dir, str(src), ".out")
     options_str = compile_options.strip() if compile_options else "-O3"
-    cmd = [gcc_path] + shlex.split(options_str) + [str(src), "-o", str(out)]
+    extra = profiler.extra_options if profiler is not None else []
+    cmd = [gcc_path] + shlex.split(options_str) + extra + [str(src)] + stage_output_args(stage, str(out), options_str)
     print(f"[Compile] {' '.join(cmd)}")
-    try:
-        subprocess.run(
-            cmd,
-            check=True,
-            stdout=subprocess.PIPE,
-            stderr=subprocess.PIPE,
-            encoding="utf-8",
-            timeout=timeout_sec,
-        )
-        return True, None
-    except subprocess.TimeoutExpired:
+    returncode, stdout, stderr, usage = run_profiled(cmd, timeout_sec, env)
+    passes, ggc_kb = {}, None
+    if extra:
+        stderr, passes, ggc_kb = split_reports(stderr)
+    if profiler is not None:
+        profiler.record(str(src), options_str, stage, returncode == 0, returncode is None, usage, passes, ggc_kb)
+
+    if returncode is None:
         return False, f"Compilation error: Timeout (> {timeout_sec}s)"
-    except subprocess.CalledProcessError as e:
-        stderr = (e.stderr or "").strip()
-        stdout = (e.stdout or "").strip()
-        message = stderr if stderr else stdout
-        if not message:
-            message = "Unknown compilation error (no output captured)"
+    if returncode == 0:
+        return True, None
+    stderr = stderr.strip()
+    stdout = stdout.strip()
+    message = stderr if stderr else stdout
+    if not message:
+        message = "Unknown compilation error (no output captured)"
 
-        return False, f"Compilation error: {message}"
+    return False, f"Compilation error: {message}"
 
 
-def check_lines_coverage(block_text: str, gcov_file: str) -> Tuple[bool, List[int]]:
+def check_lines_coverage(block_text: str, gcov_file: str, line_counts: Optional[array] = None,
+                         new_lines: Optional[Set[int]] = None) -> Tuple[bool, List[int]]:
     """
     Check whether the target lines (extracted from an input uncovered block text)
     become covered in a given .gcov file.
@@ -170,6 +189,8 @@ def check_lines_coverage(block_text: str, gcov_file: str) -> Tuple[bool, List[in
     Parameters:
     :param block_text: The input block text (original snippet with "#####" markers)
     :param gcov_file: Path to the .gcov file to check
+    :param line_counts: In-memory per-line counts (json/native collection); if given, gcov_file is not read
+    :param new_lines: Newly covered lines of the file (edge coverage mode); if given, gcov_file is not read
 
     Returns:
     :return: (covered_any, target_lines)
@@ -184,6 +205,11 @@ def check_lines_coverage(block_text: str, gcov_file: str) -> Tuple[bool, List[in
 
     if not target_lines:
         return False, []
+    if line_counts is not None:
+        covered = any(ln < len(line_counts) and line_counts[ln] > 0 for ln in target_lines)
+        return covered, target_lines
+    if new_lines is not None:
+        return any(ln in new_lines for ln in target_lines), target_lines
     # Build a lookup set for faster membership tests
     target_set = set(target_lines)
     # Parse gcov file lines and detect if any target line is covered (numeric count)
@@ -215,34 +241,15 @@ def check_lines_coverage(block_text: str, gcov_file: str) -> Tuple[bool, List[in
         raise FileNotFoundError(f"gcov file not found: {gcov_file}")
 
 
-def parse_gcov_file(gcov_path: str) -> Dict[int, Tuple[str, str]]:
-    """Parse gcov file, return {line_num: (count, code)}."""
-    result: Dict[int, Tuple[str, str]] = {}
-    pattern = re.compile(r'^\s*(?P<count>[#\-\d]+)\s*:\s*(?P<lineno>\d+)\s*:(?P<code>.*)$')
-    try:
-        with open(gcov_path, "r", encoding="utf-8", errors="replace") as f:
-            for line in f:
-                m = pattern.match(line)
-                if m:
-                    ln = int(m.group("lineno"))
-                    result[ln] = (m.group("count").strip(), m.group("code"))
-    except FileNotFoundError:
-        pass
-    return result
-
-
-def collect_all_gcov_state(coverage_dir: str) -> Dict[str, Dict[int, Tuple[str, str]]]:
-    """Parse all .gcov files in coverage_dir, return {gcov_filename: {line_num: (count, code)}}."""
-    result: Dict[str, Dict[int, Tuple[str, str]]] = {}
-    for f in Path(coverage_dir).glob("*.gcov"):
-        result[f.name] = parse_gcov_file(str(f))
-    return result
+def collect_all_gcov_state(coverage_dir: str, previous: Optional[CoverageSnapshot] = None) -> CoverageSnapshot:
+    """Parse all .gcov files in coverage_dir into a bitset snapshot, reusing unchanged files from previous."""
+    return CoverageSnapshot.from_gcov_dir(coverage_dir, previous)
 
 
 def compute_coverage_improvements(
     target_file: str,
-    cov_before: Dict[str, Dict[int, Tuple[str, str]]],
-    cov_after: Dict[str, Dict[int, Tuple[str, str]]],
+    cov_before: CoverageSnapshot,
+    cov_after: CoverageSnapshot,
 ) -> Tuple[List[str], str]:
     """
     Compare before/after coverage.
@@ -254,27 +261,34 @@ def compute_coverage_improvements(
     improved_other_files: List[str] = []
     improved_in_file_parts: List[str] = []
 
-    for gcov_name, after_data in cov_after.items():
-        before_data = cov_before.get(gcov_name, {})
-        file_basename = gcov_name.replace(".gcov", "") if gcov_name.endswith(".gcov") else gcov_name
+    for name, newly_covered in cov_after.newly_covered(cov_before).items():
+        if name == target_basename:
+            file_cov = cov_after.files[name]
+            for ln in iter_bits(newly_covered):
+                improved_in_file_parts.append(f"{ln}:{file_cov.line_text(ln)}")
+        else:
+            improved_other_files.append(name)
 
-        newly_covered = []
-        for ln, (new_count, new_code) in after_data.items():
-            old = before_data.get(ln, ("#####", ""))
-            old_count = old[0]
-            code = old[1] or new_code
-            if old_count == "#####" and new_count.isdigit():
-                newly_covered.append((ln, code))
+    improved_in_file = "\n".join(improved_in_file_parts) if improved_in_file_parts else ""
+    return improved_other_files, improved_in_file
 
-        if not newly_covered:
-            continue
 
-        if file_basename == target_basename or gcov_name == target_basename + ".gcov":
-            for ln, code in sorted(newly_covered):
+def compute_edge_improvements(target_file: str, new_lines: Dict[str, Set[int]]) -> Tuple[List[str], str]:
+    """
+    Same result as compute_coverage_improvements, from the newly hit lines of edge coverage mode.
+    :param new_lines: {source path: newly covered line numbers}, see EdgeCoverage.take_new_lines
+    """
+    target_basename = os.path.basename(target_file.replace("\\", "/"))
+    improved_other_files: List[str] = []
+    improved_in_file_parts: List[str] = []
+    for path, lines in sorted(new_lines.items()):
+        name = os.path.basename(path)
+        if name == target_basename:
+            for ln in sorted(lines):
+                code = linecache.getline(path, ln).rstrip("\n")
                 improved_in_file_parts.append(f"{ln}:{code}")
-        else:
-            improved_other_files.append(file_basename)
-
+        elif name not in improved_other_files:
+            improved_other_files.append(name)
     improved_in_file = "\n".join(improved_in_file_parts) if improved_in_file_parts else ""
     return improved_other_files, improved_in_file
 
@@ -436,7 +450,90 @@ def main():
     )
     GCC_PATH = "../gcc-ztc-build/bin/gcc"
     GCOV_PATH = "gcov-13"  
+    GCOV_TOOL_PATH = "gcov-tool-13"  # Merges per-worker .gcda profiles after parallel compilation
+    COMPILE_WORKERS = os.cpu_count() or 1  # Concurrent compiler processes per batch (1 = serial)
+    COMPILE_TIMEOUT = 60  # Per-program compilation timeout in seconds
+    COMPILE_MERGE_BACKEND = "native"  # Fold worker .gcda files by summing counters in-process, or "gcov-tool"
+    STAGE_AWARE_COMPILE = True  # Stop compiling at the earliest stage that exercises the target file
+    COMPILE_FORKSERVER = False  # Run cc1 from pre-initialized fork servers (assembly only, no as/ld)
+    COMPILE_DIRECT_CC1 = False  # Without fork servers: exec the cached cc1 command when the stage needs no as/ld
+    # Compile profiling: wall/user/sys time and peak RSS of every compile (optionally -ftime-report/-fmem-report)
+    # in a per-run table under PROFILE_DIR; compiles or passes far above the median are flagged as outliers
+    COMPILE_PROFILE = False
+    COMPILE_TIME_REPORT = False
+    COMPILE_MEM_REPORT = False
+    COMPILE_OUTLIER_FACTOR = 100.0  # Times the median wall time (whole compile or one pass) that flags a compile
+    PROFILE_DIR = "xxx/GapSmith/compile_profiles"
+    # Scratch workspace: compile outputs, worker GCOV_PREFIX trees, .gcov reports and a working copy of the
+    # .gcda profiles live on a tmpfs; profiles and reports are written back every SCRATCH_CHECKPOINT_EVERY
+    # iterations (in the background) and at the end
+    USE_SCRATCH = False
+    SCRATCH_DIR = "/dev/shm/gapsmith"  # Parent of the per-run scratch directories (run_*)
+    SCRATCH_CHECKPOINT_EVERY = 5
+    # Syntax pre-filter: check every generated program in parallel with the fast host compiler
+    # (-fsyntax-only) and only send programs that pass to the instrumented GCC
+    SYNTAX_PREFILTER = True
+    # Local repair of programs failing that check: missing headers, implicit declarations, leftover prose
+    REPAIR_PROGRAMS = True
+    HOST_CC = "gcc"  # Uninstrumented compiler of the pre-filter and repair checks
+    # Option validation: drop or correct suggested options the instrumented GCC does not accept (other targets,
+    # misspellings, out-of-range --param values); every rejection is logged to OPTION_REJECTIONS
+    OPTION_VALIDATION = True
+    OPTION_REJECTIONS = "xxx/GapSmith/option_rejections.jsonl"
+    # Skip programs already compiled in this run (same normalized source, options and compiler); entries are
+    # per run since a hit adds no counters to the profiles
+    COMPILE_CACHE = True
+    COMPILE_CACHE_DIR = "xxx/GapSmith/compile_cache"  # Parent of the per-run cache directories (run_*)
+    # Option matrix: preprocess each program once and recompile the .i files under the extracted option sets
+    # and OPTION_MATRIX_OPTIONS (None = algorithm/option_matrix.py defaults) until the target block is covered
+    OPTION_MATRIX = False
+    OPTION_MATRIX_OPTIONS = None
+    OPTION_MATRIX_MAX_ROUNDS = 6  # Extra option sets per batch at most
+    # Option fuzzing: recompile corpus programs (OUTPUT_DIR/batch_*) under mutated -f/--param/-march combinations,
+    # keeping those that cover new lines of the target file. OPTION_FUZZING replaces the LLM steps entirely;
+    # FUZZ_WHEN_IDLE fills iterations where summarization or generation failed (e.g. rate limits)
+    OPTION_FUZZING = False
+    FUZZ_WHEN_IDLE = True
+    FUZZ_ROUNDS = 20  # Option combinations per target
+    FUZZ_PROGRAMS_PER_ROUND = 16  # Corpus programs compiled per combination
+    FUZZ_LOG = "xxx/GapSmith/option_fuzz.jsonl"
+    # Edge coverage mode: GCC built with -fsanitize-coverage=trace-pc and algorithm/edge_runtime.c gives
+    # per-iteration feedback from shared-memory hit maps; gcov only refreshes the reports every few iterations
+    EDGE_COVERAGE = False
+    EDGE_CC1_PATH = "../gcc-ztc-build/libexec/gcc/x86_64-pc-linux-gnu/14.3.0/cc1"
+    EDGE_GCOV_REFRESH = 10  # Iterations between gcov collections in edge coverage mode
+    COVERAGE_ATTRIBUTION = False  # Record which program covered which new lines (one .gcda prefix per compile)
+    ATTRIBUTION_DB = "xxx/GapSmith/attribution.sqlite"
+    GCOV_WORKERS = os.cpu_count() or 1  # Concurrent gcov processes during coverage collection (1 = serial)
+    GCOV_INCREMENTAL = True  # Only re-run gcov for translation units whose .gcda counters changed
+    # "gcov" runs GCOV_PATH and works on .gcov files in COVERAGE_DIR;
+    # "json" (gcov --json-format --stdout) and "native" (.gcno/.gcda reader) keep line counts in memory
+    GCOV_BACKEND = "gcov"
     COVERAGE_DIR = "xxx/GapSmith/coverage"
+    # Uncovered blocks of all files, re-indexed after each collection for the files whose coverage changed
+    BLOCK_INDEX_DIR = "xxx/GapSmith/block_index"
+    BLOCK_MAX_ATTEMPTS = 3  # Generation rounds aimed at one block before it is passed over
+    # Block context from the source structure (enclosing function signature, guarding conditions and
+    # switch cases) instead of the 20 covered lines around the block; the scanned structure of each
+    # source file is cached in SOURCE_INDEX_DIR
+    STRUCTURAL_CONTEXT = True
+    SOURCE_INDEX_DIR = "xxx/GapSmith/source_index"
+    # Rank blocks and files by their distance from executed code over the static call graph of the instrumented
+    # translation units (calls from an executed function + uncovered guarding conditions); needs STRUCTURAL_CONTEXT
+    CALL_GRAPH_FRONTIER = True
+    FRONTIER_MAX_DISTANCE = 2  # Blocks at most this far count as near the frontier for file selection
+    FRONTIER_FLOOR = 0.1  # Selection weight of a file with no uncovered block near the frontier
+    # Reachability of each instrumented file from the build's link structure (which of BUILD_BINARIES its
+    # object is linked into); files linked only outside COMPILE_PATH_BINARIES (gcov, gcov-tool, ...) can
+    # never gain coverage and get UNREACHABLE_WEIGHT in file selection (0 = never selected)
+    BINARY_MEMBERSHIP = True
+    BUILD_BINARIES = ["xgcc", "cpp", "cc1", "cc1plus", "lto1", "lto-wrapper", "collect2", "gcov", "gcov-dump",
+                      "gcov-tool"]
+    # Binaries a compile runs: programs are linked by default (collect2) and the "lto" stage runs lto-wrapper and
+    # lto1 (see stage_map.py); drop them only if programs are never linked
+    COMPILE_PATH_BINARIES = ["xgcc", "cc1", "collect2", "lto-wrapper", "lto1"]
+    UNREACHABLE_WEIGHT = 0.0
+    REACHABILITY_FILE = "xxx/GapSmith/reachability.json"
     OUTPUT_DIR = "xxx/GapSmith/programs"
     PROMPT_DIR = "xxx/GapSmith/prompts"
     BAD_CASES_DIR = "xxx/GapSmith/bad_cases"
@@ -462,8 +559,23 @@ def main():
     sys.path.insert(0, str(Path(__file__).parent))
     from algorithm.generate import BatchCodeGenerator
     from algorithm.collect import GcovRunner
+    from algorithm.compile_pool import CompileScheduler
+    from algorithm.attribution import CoverageAttributionDB
+    from algorithm.forkserver import ForkServerCompiler
+    from algorithm.direct_cc1 import DirectCC1Compiler
+    from algorithm.compile_cache import CompileCache
+    from algorithm.scratch import ScratchWorkspace
+    from algorithm.repair import ProgramRepairer
+    from algorithm.syntax_filter import SyntaxPrefilter
+    from algorithm.option_validator import OptionValidator
+    from algorithm.option_matrix import OptionMatrixRunner, TargetProbe
+    from algorithm.option_fuzzer import OptionFuzzer
+    from algorithm.edge_coverage import EdgeCoverage
     from algorithm.sort import GapSmithSelector
-    from algorithm.uncovered_analyzer import UncoveredBlockAnalyzer
+    from algorithm.block_index import BlockIndex
+    from algorithm.source_index import SourceIndex
+    from algorithm.call_graph import CallGraph
+    from algorithm.binary_membership import BinaryMembership
     from algorithm.summarize import UncoveredRequirementSummarizer
     from algorithm.find_bad import BadCaseFinder
 
@@ -481,7 +593,10 @@ def main():
         api_key=api_key,
         output_dir="summaries",  # relative path, created in cwd
     )
-    finder = BadCaseFinder(bad_cases_dir=BAD_CASES_DIR)
+    # Worker .gcda trees mirror the common root of all profile directories (GCOV_PREFIX_STRIP)
+    profile_root = os.path.commonpath([os.path.abspath(d) for d in source_dirs])
+    attribution = CoverageAttributionDB(ATTRIBUTION_DB, profile_root) if COVERAGE_ATTRIBUTION else None
+    finder = BadCaseFinder(bad_cases_dir=BAD_CASES_DIR, attribution=attribution)
 
     # ---------- Phase 1: Initial program generation ----------
     print("[Phase 1] Initial program generation...")
@@ -508,41 +623,132 @@ def main():
     else:
         print("[Compile] Initial program compiled successfully")
 
+    # Binaries, objects and generated sources live in the build tree (not mirrored to scratch); membership is
+    # derived once per build
+    build_dirs = list(source_dirs)
+    membership = None
+    if BINARY_MEMBERSHIP:
+        membership = BinaryMembership(build_dirs, BUILD_BINARIES, COMPILE_PATH_BINARIES, REACHABILITY_FILE)
+        membership.refresh()
+
+    # Move the live profiles and reports to the scratch workspace (after the initial compile, which wrote
+    # its counters to the persistent profiles); profile_root keeps naming the original tree for
+    # GCOV_PREFIX_STRIP and attribution
+    scratch = ScratchWorkspace(SCRATCH_DIR) if USE_SCRATCH else None
+    fold_root = None
+    if scratch is not None:
+        fold_root, source_dirs = scratch.mirror_profiles(source_dirs)
+        COVERAGE_DIR = scratch.mirror(COVERAGE_DIR, "coverage")
+        print(f"[Scratch] Working in {scratch.root}")
+
     # Collect coverage
+    in_memory = GCOV_BACKEND != "gcov"
     orig_cwd = os.getcwd()
-    try:
-        os.chdir(COVERAGE_DIR)
-        runner = GcovRunner(source_dirs, target_dirs, output_dir=COVERAGE_DIR, gcov_path=GCOV_PATH)
-        runner.run()
-        print(f"[Coverage] Collected, avg: {runner.compute_average_coverage():.2f}%")
-    finally:
-        os.chdir(orig_cwd)
+    runner = GcovRunner(source_dirs, target_dirs, output_dir=COVERAGE_DIR, gcov_path=GCOV_PATH,
+                        max_workers=GCOV_WORKERS, incremental=GCOV_INCREMENTAL, backend=GCOV_BACKEND,
+                        export_gcov=False)
+    source_index = SourceIndex(SOURCE_INDEX_DIR, source_roots=target_dirs) if STRUCTURAL_CONTEXT else None
+    block_index = BlockIndex(BLOCK_INDEX_DIR, context_limit=20, max_attempts=BLOCK_MAX_ATTEMPTS,
+                             source_index=source_index)
+    call_graph = None
+    if CALL_GRAPH_FRONTIER and source_index is not None:
+        call_graph = CallGraph(source_index, build_dirs=build_dirs)
+
+    def collect_coverage():
+        # The gcov executable writes .gcov files into the current directory
+        if in_memory:
+            runner.run()
+            block_index.refresh(line_counts=runner.line_counts, source_paths=runner.source_paths)
+        else:
+            try:
+                os.chdir(COVERAGE_DIR)
+                runner.run()
+            finally:
+                os.chdir(orig_cwd)
+            block_index.refresh(gcov_dir=COVERAGE_DIR)
+        if call_graph is not None:
+            block_index.update_frontier(call_graph)
+
+    profiler = None
+    if COMPILE_PROFILE:
+        profiler = CompileProfiler(PROFILE_DIR, time_report=COMPILE_TIME_REPORT, mem_report=COMPILE_MEM_REPORT,
+                                   outlier_factor=COMPILE_OUTLIER_FACTOR)
+    scratch_outputs = scratch.path("outputs") if scratch is not None else None
+    compile_one = compile_program
+    if profiler is not None or scratch_outputs is not None:
+        compile_one = functools.partial(compile_program, profiler=profiler, output_dir=scratch_outputs)
+    forkserver = None
+    if COMPILE_FORKSERVER:
+        forkserver = ForkServerCompiler(compile_one, profiler=profiler, output_dir=scratch_outputs)
+    if forkserver is not None:
+        compile_fn = forkserver
+    elif COMPILE_DIRECT_CC1:
+        compile_fn = DirectCC1Compiler(compile_one, profiler=profiler, output_dir=scratch_outputs)
+    else:
+        compile_fn = compile_one
+    compile_cache = CompileCache(compile_fn, COMPILE_CACHE_DIR) if COMPILE_CACHE else None
+    if compile_cache is not None:
+        compile_fn = compile_cache
+    edge = EdgeCoverage(EDGE_CC1_PATH) if EDGE_COVERAGE else None
+    edge_covered: Dict[str, Set[int]] = {}  # Edge-covered lines per file basename since the last gcov collection
+    compiler = CompileScheduler(edge.wrap(compile_fn) if edge is not None else compile_fn,
+                                max_workers=COMPILE_WORKERS, timeout_sec=COMPILE_TIMEOUT,
+                                gcov_tool_path=GCOV_TOOL_PATH, profile_root=profile_root,
+                                profile_dir=scratch.path("workers") if scratch is not None else None,
+                                merge_backend=COMPILE_MERGE_BACKEND, per_program_profiles=COVERAGE_ATTRIBUTION,
+                                fold_root=fold_root)
+    repairer = ProgramRepairer(HOST_CC, max_workers=COMPILE_WORKERS) if REPAIR_PROGRAMS else None
+    prefilter = SyntaxPrefilter(HOST_CC, max_workers=COMPILE_WORKERS, repairer=repairer) if SYNTAX_PREFILTER else None
+    validator = OptionValidator(GCC_PATH, OPTION_REJECTIONS) if OPTION_VALIDATION else None
+    matrix = OptionMatrixRunner(compiler, OPTION_MATRIX_OPTIONS, OPTION_MATRIX_MAX_ROUNDS) if OPTION_MATRIX else None
+    probe = TargetProbe(source_dirs)
+    fuzzer = None
+    if OPTION_FUZZING or FUZZ_WHEN_IDLE:
+        fuzzer = OptionFuzzer(compiler, OUTPUT_DIR, GCC_PATH, probe, log_path=FUZZ_LOG,
+                              programs_per_round=FUZZ_PROGRAMS_PER_ROUND)
+
+    def fuzz_target(target_file: str) -> int:
+        gained = fuzzer.run(target_file, FUZZ_ROUNDS,
+                            stage_for=(lambda o: compile_stage(target_file, o)) if STAGE_AWARE_COMPILE else None)
+        if edge is not None:
+            # Keep the fuzzed lines out of the next batch's edge feedback
+            for path, lines in edge.take_new_lines().items():
+                edge_covered.setdefault(os.path.basename(path), set()).update(lines)
+        elif gained:
+            # Likewise for the gcov reports the next batch is compared against
+            collect_coverage()
+        return gained
+
+    collect_coverage()
+    print(f"[Coverage] Collected, avg: {runner.compute_average_coverage():.2f}%")
 
     # ---------- Phase 2: Coverage-driven loop ----------
     # Record the number of consecutive coverage failures for each file, if it exceeds 10 times, it will not be selected, if it succeeds once, it will be reset
     file_failure_count: Dict[str, int] = {}
     FAILURE_THRESHOLD = 10
+    cov_snapshot: Optional[CoverageSnapshot] = None  # Last coverage snapshot, reused for unchanged files
 
     iteration = 0
     while datetime.now() < end_time:
         iteration += 1
         print(f"\n[Iteration {iteration}]")
+        if scratch is not None and iteration % SCRATCH_CHECKPOINT_EVERY == 0:
+            scratch.checkpoint()
 
         if not os.path.isdir(COVERAGE_DIR):
             print("[Error] Coverage dir not found")
             break
 
         # 2.1 Select target file
-        selector = GapSmithSelector(report_folder=COVERAGE_DIR)
+        file_weights = membership.file_weights(UNREACHABLE_WEIGHT) if membership is not None else {}
+        if call_graph is not None:
+            for name, weight in block_index.frontier_weights(FRONTIER_MAX_DISTANCE, FRONTIER_FLOOR).items():
+                file_weights[name] = file_weights.get(name, 1.0) * weight
+        selector = GapSmithSelector(report_folder=COVERAGE_DIR, file_weights=file_weights)
         selector.parse_all_reports()
         if not selector.targets:
             print("[Warning] No targets in coverage report, re-collecting...")
-            try:
-                os.chdir(COVERAGE_DIR)
-                runner = GcovRunner(source_dirs, target_dirs, output_dir=COVERAGE_DIR, gcov_path=GCOV_PATH)
-                runner.run()
-            finally:
-                os.chdir(orig_cwd)
+            collect_coverage()
             selector.parse_all_reports()
         if not selector.targets:
             print("[Error] Still no targets, skipping iteration")
@@ -561,21 +767,32 @@ def main():
             continue
         print(f"  Target file: {target_file} (consecutive failures: {file_failure_count.get(target_file, 0)})")
 
+        if OPTION_FUZZING:
+            # LLM-free mode: fuzz options over the corpus instead of generating programs
+            if fuzz_target(target_file):
+                file_failure_count[target_file] = 0
+            else:
+                file_failure_count[target_file] = file_failure_count.get(target_file, 0) + 1
+            if edge is not None and iteration % EDGE_GCOV_REFRESH == 0:
+                collect_coverage()
+                edge_covered.clear()
+            continue
+
         # 2.2 Select target block (uncovered)
         gcov_dir = COVERAGE_DIR
         base_name = os.path.basename(target_file.replace("\\", "/"))
         gcov_file = os.path.join(gcov_dir, base_name + ".gcov")
-        if not os.path.isfile(gcov_file):
-            print(f"  [Warning] Gcov file not found: {gcov_file}")
-            continue
-
-        analyzer = UncoveredBlockAnalyzer(gcov_file, context_limit=20)
-        analyzer.parse()
-        if not analyzer.blocks:
-            print("  [Warning] No uncovered blocks in file")
+        # The gcov reports are stale in edge coverage mode: skip blocks hit since the last collection
+        target_block = block_index.best_block(base_name, exclude_lines=edge_covered.get(base_name))
+        if target_block is None:
+            # Every block is covered or hit BLOCK_MAX_ATTEMPTS: exclude the file like one that keeps failing
+            print(f"  [Warning] No uncovered blocks indexed for: {base_name}")
+            file_failure_count[target_file] = FAILURE_THRESHOLD
             continue
-        analyzer.blocks.sort(key=lambda b: b["block_size"], reverse=True)
-        target_block = analyzer.blocks[0]
+        print(f"  Target block: lines {target_block['start']}-{target_block['end']} in "
+              f"{target_block['function'] or '<file scope>'} (size {target_block['block_size']}, "
+              f"attempts {target_block['attempts']}"
+              + (f", frontier distance {target_block['distance']}" if "distance" in target_block else "") + ")")
         uncovered_block_text = format_uncovered_block(target_block)
 
         # 2.3 Build summarization prompt and call summarize
@@ -585,11 +802,15 @@ def main():
         requirements = summarizer.run(sum_prompt, iteration_index=iteration, retry_times=3)
         if not requirements:
             print("  [Warning] Summarization failed")
+            if FUZZ_WHEN_IDLE:
+                fuzz_target(target_file)
             continue
 
         parsed = parse_requirements(requirements)
         coverage_goal = parsed.get("coverage_goal") or "Cover the uncovered compiler code blocks"
         compile_options = clean_compile_options(parsed.get("compile_options") or "-O2") or "-O2"
+        if validator is not None:
+            compile_options = validator.validate(compile_options) or "-O2"
         target_block_str = parsed.get("target_block") or uncovered_code
 
         # 2.4 Find bad cases
@@ -612,6 +833,8 @@ def main():
         gen_stats = generator.generate_batch(batch_size=LOOP_BATCH_SIZE, base_prompt=full_prompt, prefix="iter")
         batch_dir = gen_stats.get("batch_dir")
         if not batch_dir:
+            if FUZZ_WHEN_IDLE:
+                fuzz_target(target_file)
             continue
         batch_path = Path(batch_dir)
         c_files = sorted(batch_path.glob("*.c"))
@@ -619,32 +842,99 @@ def main():
             continue
 
         # 2.7 Collect coverage before compilation
-        cov_before = collect_all_gcov_state(COVERAGE_DIR)
+        cov_before = cov_snapshot
+        if in_memory:
+            cov_before = CoverageSnapshot.from_line_counts(runner.line_counts, runner.source_paths, cov_snapshot)
+        elif edge is None or attribution is not None:
+            cov_before = collect_all_gcov_state(COVERAGE_DIR, cov_snapshot)
 
         # 2.8 Compile all programs and concatenate compile errors
+        # (with attribution, each program's own counters are compared with cov_before before folding)
+        before_fold = None
+        if attribution is not None:
+            def before_fold(programs):
+                attribution.attribute(programs, cov_before, target_file, compile_options)
+        stage = compile_stage(target_file, compile_options) if STAGE_AWARE_COMPILE else None
+        if stage is not None:
+            print(f"  [Stage] Compiling up to: {stage}")
         compile_errors: List[str] = []
-        for c_file in c_files:
-            success, compile_err = compile_program(str(c_file), compile_options, GCC_PATH)
-            if not success:
-                compile_errors.append(f"[{c_file.name}] {compile_err or 'Unknown error'}")
+        programs = [str(c) for c in c_files]
+        host_checker = prefilter if prefilter is not None else repairer
+        if host_checker is not None:
+            # Programs the host compiler rejects (even after repair) never reach the instrumented GCC
+            programs, rejected = host_checker.run(programs, compile_options)
+            compile_errors.extend(f"[{Path(p).name}] Compilation error: {msg}" for p, msg in rejected)
+        compiled: List[str] = []
+        for c_path, success, compile_err in compiler.run(programs, compile_options, GCC_PATH,
+                                                         before_fold=before_fold, stage=stage):
+            if success:
+                compiled.append(c_path)
+            else:
+                compile_errors.append(f"[{Path(c_path).name}] {compile_err or 'Unknown error'}")
+        if prefilter is not None:
+            prefilter.observe(compiler.last_run_stats)
         compile_status = "\n".join(compile_errors) if compile_errors else "All programs compiled successfully"
 
-        # 2.9 Collect coverage after compilation
-        try:
-            os.chdir(COVERAGE_DIR)
-            runner = GcovRunner(source_dirs, target_dirs, output_dir=COVERAGE_DIR, gcov_path=GCOV_PATH)
-            runner.run()
-        finally:
-            os.chdir(orig_cwd)
+        # 2.8.1 Option matrix: recompile the preprocessed programs under further option sets until covered
+        matrix_new_lines: Dict[str, Set[int]] = {}  # Edge coverage mode: lines hit during the matrix rounds
+        if matrix is not None:
+            _, target_lines = check_lines_coverage(uncovered_block_text, gcov_file, new_lines=set())
+
+            def target_covered() -> bool:
+                if edge is not None:
+                    for path, lines in edge.take_new_lines().items():
+                        matrix_new_lines.setdefault(path, set()).update(lines)
+                    return any(os.path.basename(path) == base_name and lines.intersection(target_lines)
+                               for path, lines in matrix_new_lines.items())
+                return probe.covered(base_name, target_lines)
+
+            def matrix_before_fold(options):
+                # New lines are attributed relative to cov_before, i.e. to the state before the batch
+                if attribution is None:
+                    return None
+                return lambda programs: attribution.attribute(programs, cov_before, target_file, options)
+
+            if target_lines and not target_covered():
+                extracted = extract_compile_commands(requirements)
+                if validator is not None:
+                    extracted = [o for o in map(validator.validate, extracted) if o]
+                matrix.run(compiled, compile_options, extracted,
+                           GCC_PATH, stage_for=(lambda o: compile_stage(target_file, o)) if STAGE_AWARE_COMPILE else None,
+                           before_fold_for=matrix_before_fold, is_covered=target_covered)
+        if compile_cache is not None:
+            print(f"  [Cache] {compile_cache.summary()}")
+        if profiler is not None:
+            print(f"  [Profile] {profiler.summary()}")
 
-        cov_after = collect_all_gcov_state(COVERAGE_DIR)
-        improved_other_files_list, improved_in_file_str = compute_coverage_improvements(
-            target_file, cov_before, cov_after
-        )
+        # 2.9 Collect coverage after compilation
+        target_new_lines = None
+        if edge is not None:
+            new_lines = edge.take_new_lines()
+            for path, lines in matrix_new_lines.items():
+                new_lines.setdefault(path, set()).update(lines)
+            improved_other_files_list, improved_in_file_str = compute_edge_improvements(target_file, new_lines)
+            for path, lines in new_lines.items():
+                edge_covered.setdefault(os.path.basename(path), set()).update(lines)
+            target_new_lines = edge_covered.get(base_name, set())
+            if iteration % EDGE_GCOV_REFRESH == 0:
+                collect_coverage()
+                edge_covered.clear()
+        else:
+            collect_coverage()
+            if in_memory:
+                cov_after = CoverageSnapshot.from_line_counts(runner.line_counts, runner.source_paths, cov_before)
+            else:
+                cov_after = collect_all_gcov_state(COVERAGE_DIR, cov_before)
+            cov_snapshot = cov_after
+            improved_other_files_list, improved_in_file_str = compute_coverage_improvements(
+                target_file, cov_before, cov_after
+            )
         improved_other_files_str = ", ".join(improved_other_files_list) if improved_other_files_list else ""
 
         # 2.10 Check if target block is covered
-        covered_any, _ = check_lines_coverage(uncovered_block_text, gcov_file)
+        covered_any, _ = check_lines_coverage(uncovered_block_text, gcov_file,
+                                              runner.line_counts.get(base_name) if in_memory and edge is None else None,
+                                              target_new_lines)
 
         # Save prompt for each iteration
         ts = datetime.now().strftime("%Y%m%d_%H%M%S")
@@ -652,6 +942,7 @@ def main():
         prompt_path.write_text(full_prompt, encoding="utf-8")
         print(f"  [Prompt] Saved: {prompt_path}")
 
+        block_index.record_attempt(base_name, target_block, covered_any)
         if covered_any:
             # Covered: reset failure count
             file_failure_count[target_file] = 0
@@ -672,9 +963,40 @@ def main():
                 "improved_other_files": improved_other_files_str,
                 "improved_in_file": improved_in_file_str[:500] if improved_in_file_str else "",
             }
+            if attribution is not None:
+                case_data["programs"] = [[CoverageAttributionDB.program_hash(str(c)), compile_options]
+                                         for c in c_files]
             case_path.write_text(json.dumps(case_data, indent=2, ensure_ascii=False), encoding="utf-8")
             print(f"  [Not covered] Bad case saved: {case_path}")
 
+    compiler.close()
+    if attribution is not None:
+        attribution.close()
+    if forkserver is not None:
+        forkserver.close()
+    if prefilter is not None:
+        print(f"[Prefilter] {prefilter.stats['rejected']}/{prefilter.stats['checked']} rejected, "
+              f"est. {prefilter.stats['time_saved']:.1f}s saved")
+    if repairer is not None:
+        print(f"[Repair] {repairer.stats}")
+    if validator is not None:
+        print(f"[Options] {validator.summary()}")
+    if source_index is not None:
+        print(f"[SourceIndex] {source_index.stats}")
+    if compile_cache is not None:
+        print(f"[Cache] {compile_cache.summary()}")
+        compile_cache.close()
+    if profiler is not None:
+        print(f"[Profile] {profiler.summary()}; table: {profiler.table_path}")
+    if edge is not None:
+        # Final, precise reporting still goes through gcov
+        collect_coverage()
+        print(f"[Coverage] Final avg: {runner.compute_average_coverage():.2f}%")
+        edge.close()
+    if scratch is not None:
+        scratch.close()
+        print(f"[Scratch] {scratch.stats['checkpoints']} checkpoints, {scratch.stats['files']} files synced "
+              f"in {scratch.stats['sync_time']:.1f}s")
     print("\n[Done] Coverage-driven loop finished.")
 
 